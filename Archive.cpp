@@ -1,37 +1,123 @@
 
 #include "Archive.h"
 
+#ifdef _MSC_VER
+#include <intrin.h>
+#elif defined(__BMI2__)
+#include <immintrin.h>
+#endif
+
 using namespace Serialize;
 
+static inline uint32 CountTrailingZeros(uint64 bits)     //bits != 0
+{
+#ifdef _MSC_VER
+    unsigned long index;
+    _BitScanForward64(&index, bits);
+    return uint32(index);
+#else
+    return uint32(__builtin_ctzll(bits));
+#endif
+}
+
 //Archive non-templatized implementations
 void Archive::Reset()
 {
-    _mapTypeId.clear();
-    _mapObjShared.clear();
-    _mapIdType.clear();
-    _mapIdObj.clear();
+    if(!IsFormat(Session))      //a session keeps its type ids, the peer has them
+        ResetTypes();
     _mapObjId.clear();
-    _mapIdObj[ID_NULL]  = nullptr;
+    _vecIdObj.assign(ID_START, nullptr);
+    _vecIdShared.assign(ID_START, nullptr);
     _mapObjId[nullptr]  = ID_NULL;
     _nextObjId          = ID_START;
-    _nextTypeId         = ID_START;
-    _hash               = BIG_PRIME;
+    _deferred.clear();
+    _deferPos           = 0;
+    if(_mode == LoadArchive)
+        _viewCopies.clear();    //views of the previous message end with it, saves may still forward them
+    _hash               = HashSeed();
+    _bTag               = (_format != Legacy);
+    _saveHashed         = _savePos;     //staged bytes from before the reset are not part of the new hash
+    _loadHashed         = _loadPos;
     _error              = 0;
 }
 
+void Archive::ResetTypes()
+{
+    _mapTypeId.clear();
+    _vecIdType.assign(ID_START, nullptr);
+    _nextTypeId = ID_START;
+    _tagged     = 0;
+}
+
+void Archive::Flush()
+{
+    if(_mode != SaveArchive) return;
+    if(!Drain())
+        return Error();
+    _source.flush();
+}
+
+void Archive::TagStream()
+{
+    _bTag = false;
+    if(IsFormat(Session) && (_tagged & (1 << _mode)))
+        return;                 //tagged once per direction, the format can not change mid session
+    uint8 magic = TAG_MAGIC;
+    if(IsSave())
+    {
+        save(&magic, sizeof(magic));
+        SaveDint(_format);
+    }
+    else
+    {
+        if((load(&magic, sizeof(magic)) != sizeof(magic)) || (magic != TAG_MAGIC))
+            return Error();
+        uint64 format = LoadDint();
+        if(!(format & Tagged) || ((format & HashMask) == HashMask) || ((format & (Global | Delta)) == (Global | Delta)) ||
+           (format > 0xFFFFFFFF))
+            return Error();
+        _format = uint32(format);
+    }
+    _tagged    |= 1 << _mode;
+    _hash       = HashSeed();   //the running hash starts after the tag, in the tagged algorithm
+    _saveHashed = _savePos;
+    _loadHashed = _loadPos;
+}
+
+void Archive::SerializeDeferred()     //drain the Iterative work queue, the same order on save and load
+{
+    _depth++;
+    while((_deferPos < _deferred.size()) && !IsError())
+        _deferred[_deferPos++]->Serialize(*this);
+    _deferred.clear();
+    _deferPos = 0;
+    _depth--;
+}
+
 bool Archive::CheckPoint()
 {
+    Tag();
     if(IsError()) return false;
+    if(HashType() == (NoHash & HashMask))   //nothing recorded, still a flush point
+    {
+        Flush();
+        Unload();
+        return !IsError() && (_mode != Unknown);
+    }
     switch(_mode)
     {
     case SaveArchive:
-        Save(_hash);
-        return true;
+        HashSaved();
+        SaveFixed(_hash);
+        Flush();
+        return !IsError();
     case LoadArchive:
     {
+        HashLoaded();
         uint32 hash = _hash;
         uint32 fileHash = {};
-        Load(fileHash);
+        LoadFixed(fileHash);
+        Unload();
         if(fileHash == hash)
             return true;
     }
@@ -45,40 +131,136 @@ bool Archive::CheckPoint()
 void Archive::Save(std::string& str)
 {
     if(IsError()) return;
-    uint32 size = uint32(str.length());
+    size_t size = str.length();
     SaveDint(size);
-    if(size && (save((BYTE*)str.data(), size) != int32(size)))
-        return Error();
+    SaveBytes((void*)str.data(), size);
 }
 void Archive::Load(std::string& str)
 {
-    if(IsError()) return;
-    uint32 size = LoadDint();
     str.clear();
-    if(size)
+    if(IsError()) return;
+    uint64 size = LoadDint();
+    int64 remaining = Remaining();
+    if((size >= SIZE_MAX) || ((remaining >= 0) && (size > uint64(remaining))))
+        return Error();
+    size_t chunk = (remaining >= 0) ? size_t(size) : size_t(CHUNK_SIZE);    //unknown length, grow as the data arrives
+    for(size_t done = 0; (done < size) && !IsError(); done += chunk)
     {
-        std::string str2(size + 1, '\0');
-        if(load((BYTE*)str2.data(), size) != int32(size))
-            return Error();
-        str.swap(str2);
+        size_t count = ((size - done) < chunk) ? size_t(size - done) : chunk;
+        str.resize(done + count);
+        LoadBytes(&str[done], count);
     }
+    if(IsError())
+        str.clear();
 }
 
-void Archive::Save(void* pVoid, uint32 size)
+#if __cplusplus >= 201703L
+void Archive::Save(std::string_view& str)
 {
     if(IsError()) return;
+    size_t size = str.size();
     SaveDint(size);
-    if(size && (save(pVoid, size) != int32(size)))
-        return Error();
+    SaveBytes((void*)str.data(), size);
 }
-void Archive::Load(void* pVoid, uint32 size)
+void Archive::Load(std::string_view& str)
 {
+    str = {};
     if(IsError()) return;
-    uint32 arcSize = LoadDint();
+    uint64 size = LoadDint();
+    if(const BYTE* pView = ViewBytes(size))
+        str = std::string_view((const char*)pView, size_t(size));
+}
+#endif
+
+#ifdef __cpp_lib_span
+void Archive::Save(std::span<const BYTE>& span)
+{
+    Save((void*)span.data(), span.size());
+}
+void Archive::Load(std::span<const BYTE>& span)
+{
+    const void* pView = nullptr;
+    size_t size = 0;
+    LoadView(pView, size);
+    span = std::span<const BYTE>((const BYTE*)pView, size);
+}
+#endif
+
+void Archive::LoadView(const void*& pView, size_t& size)
+{
+    pView = nullptr;
+    size  = 0;
+    if(IsError()) return;
+    uint64 arcSize = LoadDint();
+    if((pView = ViewBytes(arcSize)) != nullptr)
+        size = size_t(arcSize);
+}
+
+void Archive::Save(void* pVoid, size_t size)
+{
+    if(IsError()) return;
+    SaveDint(size);
+    SaveBytes(pVoid, size);
+}
+void Archive::Load(void* pVoid, size_t size)
+{
+    if(IsError()) return;
+    uint64 arcSize = LoadDint();
     if(arcSize > size)
         return Error();
-    if(arcSize && (load(pVoid, arcSize) != int32(arcSize)))
-        return Error();
+    LoadBytes(pVoid, size_t(arcSize));
+}
+
+void Archive::SaveBytes(void* pData, size_t size)
+{
+    for(BYTE* pBytes = (BYTE*)pData; size && !IsError(); )
+    {
+        uint32 count = (size < VIEW_SIZE) ? uint32(size) : uint32(VIEW_SIZE);
+        if(save(pBytes, count) != int32(count))
+            return Error();
+        pBytes += count;
+        size   -= count;
+    }
+}
+void Archive::LoadBytes(void* pData, size_t size)
+{
+    for(BYTE* pBytes = (BYTE*)pData; size && !IsError(); )
+    {
+        uint32 count = (size < VIEW_SIZE) ? uint32(size) : uint32(VIEW_SIZE);
+        if(load(pBytes, count) != int32(count))
+            return Error();
+        pBytes += count;
+        size   -= count;
+    }
+}
+
+const BYTE* Archive::ViewBytes(uint64 size)
+{
+    int64 remaining = Remaining();
+    if(IsError() || (size >= SIZE_MAX) || ((remaining >= 0) && (size > uint64(remaining))))
+        return Error(), nullptr;
+    if(!size)
+        return (const BYTE*)"";
+    if(_loadPos == _loadEnd)
+        Fill();
+    if((_pLoad != _loadBuffer.data()) && (size <= _loadEnd - _loadPos))    //inside the window the source lent
+    {
+        const BYTE* pView = _pLoad + _loadPos;
+        _loadPos += uint32(size);
+        return pView;
+    }
+    std::vector<BYTE> copy;
+    size_t chunk = (remaining >= 0) ? size_t(size) : size_t(CHUNK_SIZE);    //as Load(std::string&)
+    for(size_t done = 0; (done < size) && !IsError(); done += chunk)
+    {
+        size_t count = ((size - done) < chunk) ? size_t(size - done) : chunk;
+        copy.resize(done + count);
+        LoadBytes(copy.data() + done, count);
+    }
+    if(IsError())
+        return nullptr;
+    _viewCopies.push_back(std::move(copy));
+    return _viewCopies.back().data();
 }
 
 void Archive::SaveType(SerializableBase* pObj)
@@ -92,55 +274,341 @@ void Archive::SaveType(SerializableBase* pObj)
         typeId = _nextTypeId++;
         SaveDint(typeId);
         HASH hash = pTypeInfo->Hash();
-        Save(hash);
+        SaveFixed(hash);
     }
 }
 const TypeInfo* Archive::LoadType()
 {
     TypeId typeId = LoadDint();
-    const TypeInfo*& pTypeInfo = _mapIdType[typeId];
-    if(!pTypeInfo)
+    if(typeId < _vecIdType.size())
+        return _vecIdType[typeId];
+    if(typeId != _vecIdType.size())     //new ids are sequential
     {
-        HASH hash = 0;
-        Load(hash);
-        pTypeInfo = TypeInfo::Find(hash);
+        Error();
+        return nullptr;
     }
+    HASH hash = 0;
+    LoadFixed(hash);
+    const TypeInfo* pTypeInfo = TypeInfo::Find(hash);
+    _vecIdType.push_back(pTypeInfo);
     return pTypeInfo;
 }
 
-void Archive::SaveDint(uint32 dint)
+void Archive::ResetDelta()
 {
-    do
+    _delta.ids.clear();
+    _delta.objs.clear();
+    _delta.nextId = ID_START;
+    _delta.queue.clear();
+}
+
+Archive::ObjId Archive::DeltaId(SerializableBase* pObj, std::shared_ptr<void> shared)
+{
+    DeltaState& delta = *_pDelta;
+    ObjId* pId = delta.ids.find(pObj);
+    if(!shared && (!pId || !delta.objs.find(*pId)->shared))
+        return 0;           //its address could be freed and reused while the peer still has the id
+    ObjId& id = delta.ids[pObj];
+    if(!id)
+        id = delta.nextId++;
+    ObjId objId = id;
+    DeltaEntry& entry = delta.objs[objId];
+    entry.pObj = pObj;
+    if(shared && !entry.shared)
+        entry.shared = std::move(shared);
+    if(entry.pass != delta.pass)
+    {
+        entry.pass = delta.pass;
+        delta.queue.push_back(pObj);
+    }
+    return objId;
+}
+
+void Archive::SaveSnapshot()    //every object the queue reaches is recorded, the records the peer does not have are saved
+{
+    DeltaState& delta = _delta;
+    Archive record(delta.record, SaveArchive, RecordFormat(), 0);    //unbuffered, into memory
+    record._pDelta  = &delta;
+    record._bRecord = true;
+    for(size_t pos = 0; (pos < delta.queue.size()) && !IsError(); pos++)
     {
-        uint8 u8 = uint8(dint & 0x7f);
-        dint >>= 7;
-        if(!dint) u8 |= 0x80;
-        save(&u8, sizeof(u8));
-    } while(dint);
+        SerializableBase* pObj = delta.queue[pos];
+        delta.record.Reset();
+        record.Reset();
+        record._bTag = false;
+        pObj->Serialize(record);
+        if(record.IsError())
+            return Error();
+        ObjId objId = *delta.ids.find(pObj);
+        DeltaEntry& entry = *delta.objs.find(objId);
+        uint64 hash = Hash64::Of(delta.record.Buffer(), delta.record.Size());
+        if(entry.bSent && (entry.hash == hash))
+            continue;           //unchanged, the peer's is the same
+        SaveDint(objId * 2 + (entry.bSent ? 0 : 1));
+        if(!entry.bSent)
+            SaveType(pObj);
+        SaveDint(delta.record.Size());
+        SaveBytes((void*)delta.record.Buffer(), delta.record.Size());
+        entry.hash  = hash;
+        entry.bSent = true;
+    }
+    SaveDint(0);
+    delta.queue.clear();
 }
-uint32 Archive::LoadDint()
+
+void Archive::LoadSnapshot()    //creates the objects new to this side, then patches each record's object in place
 {
-    uint32  dint = 0;
+    DeltaState& delta = _delta;
+    std::vector<std::pair<SerializableBase*, uint64>> patches;      //object, record size
+    delta.bodies.clear();
+    for(uint64 dint; !IsError() && (dint = LoadDint()); )
+    {
+        ObjId objId = dint / 2;
+        if(objId < ID_START)
+            return Error();
+        DeltaEntry* pEntry = delta.objs.find(objId);
+        if(dint & 1)
+        {
+            const TypeInfo* pTypeInfo = LoadType();
+            if((pEntry && pEntry->pObj) || !pTypeInfo)
+                return Error();     //new twice, or an unknown type
+            std::shared_ptr<SerializableBase> ptr = pTypeInfo->CreateShared(_pArena);
+            pEntry = &delta.objs[objId];
+            pEntry->pObj   = ptr.get();
+            pEntry->shared = std::move(ptr);
+            pEntry->bSent  = true;
+            delta.ids[pEntry->pObj] = objId;
+            delta.nextId = std::max(delta.nextId, objId + 1);
+        }
+        else if(!pEntry || !pEntry->pObj)
+            return Error();         //not an object this side has
+        uint64 size = LoadDint();
+        int64 remaining = Remaining();
+        if((size >= SIZE_MAX - delta.bodies.size()) || ((remaining >= 0) && (size > uint64(remaining))))
+            return Error();
+        size_t offset = delta.bodies.size();
+        size_t chunk  = (remaining >= 0) ? size_t(size) : size_t(CHUNK_SIZE);   //as Load(std::string&)
+        for(size_t done = 0; (done < size) && !IsError(); done += chunk)
+        {
+            size_t count = ((size - done) < chunk) ? size_t(size - done) : chunk;
+            delta.bodies.resize(offset + done + count);
+            LoadBytes(delta.bodies.data() + offset + done, count);
+        }
+        if(IsError())
+            return;         //short of size bytes
+        pEntry->hash = Hash64::Of(delta.bodies.data() + offset, size_t(size));
+        patches.emplace_back(pEntry->pObj, size);
+    }
+    if(IsError())
+        return;
+    SpanSource bodies(delta.bodies);
+    Archive record(bodies, LoadArchive, RecordFormat(), 0);
+    record._pDelta  = &delta;
+    record._bRecord = true;
+    uint64 left = delta.bodies.size();
+    for(auto& patch : patches)
+    {
+        record.Reset();
+        record._bTag = false;
+        patch.first->Serialize(record);
+        left -= patch.second;
+        if(record.IsError() || (record.Remaining() != int64(left)))
+            return Error();     //a record loaded short or long
+    }
+}
+
+void Archive::SaveDint(uint64 dint)
+{
+    BYTE   bytes[MAX_DINT];
+    uint32 size = 0;
+    for(; dint >= 0x80; dint >>= 7)
+        bytes[size++] = BYTE(dint & 0x7f);
+    bytes[size++] = BYTE(dint | 0x80);
+    save(bytes, size);
+}
+uint64 Archive::LoadDint()      //decode straight from the read ahead when a whole word of it is there
+{
+    static const uint32 i = 1;
+    if(((_loadEnd - _loadPos) < sizeof(uint64)) || ((*(BYTE*)&i) != 1))
+        return LoadDintSlow();
+    uint64 word;
+    std::memcpy(&word, _pLoad + _loadPos, sizeof(word));
+    uint64 stop = word & 0x8080808080808080ULL;
+    if(!stop)
+        return LoadDintSlow();      //longer than 8 bytes
+    uint32 bits = CountTrailingZeros(stop) + 1;     //8 * bytes in the Dint
+    _loadPos += bits / 8;
+    if(bits < 64)
+        word &= (uint64(1) << bits) - 1;
+#if defined(__BMI2__)
+    return _pext_u64(word, 0x7f7f7f7f7f7f7f7fULL);
+#else
+    word &= 0x7f7f7f7f7f7f7f7fULL;                                                          //pack the 7 bit groups
+    word  = (word & 0x007f007f007f007fULL) | ((word & 0x7f007f007f007f00ULL) >> 1);
+    word  = (word & 0x00003fff00003fffULL) | ((word & 0x3fff00003fff0000ULL) >> 2);
+    word  = (word & 0x000000000fffffffULL) | ((word & 0x0fffffff00000000ULL) >> 4);
+    return word;
+#endif
+}
+uint64 Archive::LoadDintSlow()
+{
+    uint64  dint = 0;
     uint32  shift = 0;
     uint8   u8 = 0;
     do
     {
-        load(&u8, sizeof(u8));
-        dint |= (uint32(u8 & 0x7f) << shift);
+        if((load(&u8, sizeof(u8)) != sizeof(u8)) || (shift > 63) || ((shift == 63) && (u8 & 0x7e)))
+        {
+            Error();
+            return 0;
+        }
+        dint |= (uint64(u8 & 0x7f) << shift);
         shift += 7;
     } while(!(u8 & 0x80));
     return dint;
 }
 
-int32 Archive::save(void* pData, uint32 size)
+void Archive::SaveSint(int64 sint)
 {
-    Hash((BYTE*)pData, size);
-    return _source.save(pData, size);
+    SaveDint((uint64(sint) << 1) ^ uint64(sint >> 63));
+}
+int64 Archive::LoadSint()
+{
+    uint64 dint = LoadDint();
+    return int64(dint >> 1) ^ -int64(dint & 1);
 }
-int32 Archive::load(void* pData, uint32 size)
+
+int32 Archive::SaveBlock(void* pData, uint32 size)
 {
-    int32 ret = _source.load(pData, size);
+    if(size < _bufferSize)
+    {
+        if(!Stage(size))
+            return -1;
+        std::memcpy(_saveBuffer.data() + _savePos, pData, size);
+        _savePos += size;
+        return int32(size);
+    }
+    if(!Drain())                //larger than the staging buffer, write it straight through
+    {
+        Error();
+        return -1;
+    }
     Hash((BYTE*)pData, size);
-    return ret;
+    if(!Write(pData, size))
+    {
+        Error();
+        return -1;
+    }
+    return int32(size);
+}
+int32 Archive::LoadBlock(void* pData, uint32 size)
+{
+    BYTE*  pDest = (BYTE*)pData;
+    uint32 left  = size;
+    while(left)
+    {
+        uint32 avail = _loadEnd - _loadPos;
+        if(avail)
+        {
+            uint32 count = (avail < left) ? avail : left;
+            std::memcpy(pDest, _pLoad + _loadPos, count);
+            _loadPos += count;
+            pDest    += count;
+            left     -= count;
+        }
+        else if(left >= _bufferSize)    //larger than the staging buffer, read it straight through
+        {
+            HashLoaded();
+            int32 ret = _source.load(pDest, left);
+            if(ret <= 0)
+                break;
+            Hash(pDest, uint32(ret));
+            pDest += ret;
+            left  -= uint32(ret);
+        }
+        else if(!Fill())
+            break;
+    }
+    if(left)
+        Error();
+    return int32(size - left);
+}
+
+int64 Archive::Remaining()
+{
+    int64 remaining = _source.remaining();
+    return (remaining < 0) ? -1 : remaining + (_loadEnd - _loadPos);
+}
+
+bool Archive::CountFits(uint64 count)      //a corrupt count fails here, not in allocating for it
+{
+    int64 remaining = Remaining();
+    if((remaining < 0) || (count <= uint64(remaining)))
+        return true;
+    Error();
+    return false;
+}
+
+bool Archive::Stage(uint32 size)    //room for size contiguous bytes in the staging buffer
+{
+    if(size > _bufferSize)
+        return false;
+    if(_saveBuffer.size() - _savePos >= size)
+        return true;
+    if(!Drain())
+    {
+        Error();
+        return false;
+    }
+    if(_saveBuffer.size() < _bufferSize)
+        _saveBuffer.resize(_bufferSize);
+    return true;
+}
+bool Archive::Drain()
+{
+    if(!_savePos)
+        return true;
+    HashSaved();
+    bool bOk = Write(_saveBuffer.data(), _savePos);
+    _savePos = _saveHashed = 0;
+    return bOk;
+}
+bool Archive::Fill()
+{
+    HashLoaded();
+    _loadPos = _loadEnd = _loadHashed = 0;
+    uint32 size = VIEW_SIZE;
+    if((_pLoad = _source.view(size)) != nullptr)   //memory backed source, read from it in place
+    {
+        _loadEnd = size;
+        return size != 0;
+    }
+    if(_loadBuffer.size() < _bufferSize)
+        _loadBuffer.resize(_bufferSize);
+    _pLoad = _loadBuffer.data();
+    int32 ret = _source.load(_loadBuffer.data(), _bufferSize);
+    if(ret <= 0)
+        return false;
+    _loadEnd = uint32(ret);
+    return true;
+}
+void Archive::Unload()      //read ahead nobody asked for goes back, so the next reader of the source starts there
+{
+    uint32 unread = _loadEnd - _loadPos;
+    if(unread && _source.unload(unread))
+        _loadEnd = _loadPos;
+}
+bool Archive::Write(void* pData, uint32 size)    //sources may accept a partial write (e.g. send)
+{
+    BYTE* pSrc = (BYTE*)pData;
+    while(size)
+    {
+        int32 ret = _source.save(pSrc, size);
+        if(ret <= 0)
+            return false;
+        pSrc += ret;
+        size -= uint32(ret);
+    }
+    return true;
 }
 
@@ -6,30 +6,66 @@
 #include <vector>
 #include <memory>
 #include <string>
+#include <limits>
+#include <cstring>
+#if __cplusplus >= 201703L
+#include <string_view>
+#endif
+#if defined(__cpp_lib_span) || (__cplusplus > 201703L)
+#include <span>
+#endif
+#if defined(__SSSE3__) || defined(__AVX2__)
+#include <immintrin.h>
+#endif
 
 #include "types.h"
+#include "HashMap.h"
+#include "Checksum.h"
 #include "Serializable.h"
 #include "DataSource.h"
+#include "IdentityRegistry.h"
 
 namespace Serialize {
 
 template<class Type> constexpr bool is_IntegralType = std::is_integral<Type>::value;
 template<class Type> constexpr bool is_Serializable = std::is_base_of<SerializableBase, Type>::value;
-template<class Type> constexpr bool is_PlainOldData = (std::is_pod<Type>::value && !std::is_integral<Type>::value);
+template<class Type> constexpr bool is_PlainOldData = (std::is_pod<Type>::value && !std::is_integral<Type>::value && !std::is_pointer<Type>::value);     //pointers go by object id
+template<class Type> constexpr bool is_Trivial      = (is_IntegralType<Type> || is_PlainOldData<Type>);
+template<class Type> constexpr bool is_Compound     = !is_Trivial<Type>;
 
 template<class Type, class RetType = void> using if_IntegralType = std::enable_if_t<is_IntegralType<Type>, RetType>;
 template<class Type, class RetType = void> using if_Serializable = std::enable_if_t<is_Serializable<Type>, RetType>;
 template<class Type, class RetType = void> using if_PlainOldData = std::enable_if_t<is_PlainOldData<Type>, RetType>;
+template<class Type, class RetType = void> using if_Trivial      = std::enable_if_t<is_Trivial<Type>, RetType>;
+template<class Type, class RetType = void> using if_Compound     = std::enable_if_t<is_Compound<Type>, RetType>;
+
+template<typename Type> class Lazy;
 
 template<typename Type> if_IntegralType<Type, Type> ByteOrder(Type data);
+template<typename Type> if_IntegralType<Type, void> ByteOrder(BYTE* pDest, const BYTE* pSrc, size_t count);    //bulk, may be in place
 
 class Archive
 {
 public:
     enum Mode { Unknown, SaveArchive, LoadArchive, };
-
-    Archive(IDataSource& source, Mode mode= Unknown) : _source(source), _mode(mode) { Reset(); }
-    virtual ~Archive() = default;
+    enum Format                         //any format other than Legacy starts each stream with a tag recording it,
+    {                                   //a loading archive only needs to be non Legacy and adopts the tagged format
+        Legacy      = 0x00,             //untagged stream, byte-wise running hash
+        Tagged      = 0x01,
+        Checksummed = 0x02 | Tagged,    //CRC-32C running hash (hardware crc32 when built for SSE4.2)
+        NoHash      = 0x04 | Tagged,    //no running hash, CheckPoint() only flushes (trusted in-process transfers)
+        HashMask    = 0x06,
+        Iterative   = 0x08 | Tagged,    //new pointees are queued and serialized after the current object, no recursion
+        Compact     = 0x10 | Tagged,    //integers wider than a byte are saved as Dints (signed types zigzag encoded)
+        Global      = 0x20 | Tagged,    //object ids from an IdentityRegistry shared with other archives (SetRegistry)
+        Delta       = 0x40 | Tagged,    //object ids kept across Resets, a save sends only objects new or changed since
+        Session     = 0x80 | Tagged,    //type ids and the tag kept across Resets, for a long-lived connection (objects: Delta)
+    };
+    enum { BUFFER_SIZE = 64 * 1024, };     //default staging buffer, 0 == unbuffered
+
+    Archive(IDataSource& source, Mode mode= Unknown, uint32 format = Legacy, uint32 bufferSize = BUFFER_SIZE)
+        : _source(source), _mode(mode), _format(format ? (format | Tagged) : uint32(Legacy)), _bufferSize(bufferSize) { ResetTypes(); Reset(); }
+    virtual ~Archive() { Flush(); Unload(); }
 
     template<typename Type>           Archive& operator<<(Type& obj);
     template<typename Type>           Archive& operator>>(Type& obj);
@@ -37,22 +73,42 @@ public:
 
 public:
     void Reset();
+    void Flush();                                   //push staged saves through to the source
     bool CheckPoint();
 
-    void SetSave()  { if(_mode != SaveArchive) { Reset(); _mode = SaveArchive; } }
-    void SetLoad()  { if(_mode != LoadArchive) { Reset(); _mode = LoadArchive; } }
+    void SetSave()  { if(_mode != SaveArchive) { _mode = SaveArchive; Reset(); } }
+    void SetLoad()  { if(_mode != LoadArchive) { Flush(); _mode = LoadArchive; Reset(); } }
     bool IsSave()   { return _mode == SaveArchive; };
     bool IsLoad()   { return _mode == LoadArchive; };
     bool IsError()  { return _error > 0; }
+    uint32 GetFormat() const { return _format; }
+
+    void ResetDelta();                              //Delta: forget what the peer has, the next save sends everything
+    size_t DeltaObjects() const { return _delta.objs.size(); }  //Delta: objects held for the peer, until ResetDelta()
+    void ResetSession() { ResetTypes(); Reset(); }  //Session: start over, both ends (after an error too)
+
+    void SetArena(std::shared_ptr<Arena> pArena) { _pArena = std::move(pArena); }  //shared_ptr loads allocate from pArena
+    void SetRegistry(std::shared_ptr<IdentityRegistry> pRegistry) { _pRegistry = std::move(pRegistry); }   //Global ids
+    void SetRecord(SerializableBase* pRoot, std::vector<SerializableBase*>* pQueue)    //Global saves of one record
+    {                                                                                   //(IndexedWriter): only pRoot is
+        _pRecordRoot  = pRoot;                                                          //written inline, pointees new to
+        _pRecordQueue = pQueue;                                                         //the registry queue for records
+    }                                                                                   //of their own
 
 protected:
     void Error() { _error++; }
+    void Tag()   { if(_bTag && (_mode != Unknown)) TagStream(); }   //format tag, once per stream
+    void Enter() { Tag(); _depth++; }
+    void Leave() { if(!--_depth && (_deferPos < _deferred.size())) SerializeDeferred(); }
+    void Defer(SerializableBase* pObj) { _deferred.push_back(pObj); }
+    bool IsFormat(Format flag) const   { return (_format & flag & ~Tagged) != 0; }
+    template<typename Type> bool IsCompact() const { return (sizeof(Type) > 1) && IsFormat(Compact); }
 
     template<typename Type>                 if_Serializable<Type, void> Save(Type& obj);            //serializable derived object
     template<typename Type>                 if_Serializable<Type, void> Load(Type& obj);
 
     template<typename Type>                 if_Serializable<Type, void> Save(Type*& obj);           //pointer to a serializable derived object
-    template<typename Type>                 if_Serializable<Type, void> Load(Type*& obj);
+    template<typename Type>                 if_Serializable<Type, void> Load(Type*& obj, std::shared_ptr<void>* pShared = nullptr);
 
     template<typename Type, size_t count>   if_Serializable<Type, void> Save(Type(&array)[count]);  //array[] of serializable derived object
     template<typename Type, size_t count>   if_Serializable<Type, void> Load(Type(&array)[count]);
@@ -61,7 +117,7 @@ protected:
     template<typename Type>                 if_PlainOldData<Type, void> Load(Type& data);
 
     template<typename Type>                 if_PlainOldData<Type, void> Save(Type*& data);          //pointer to POD types/struct (non-ints)
-    template<typename Type>                 if_PlainOldData<Type, void> Load(Type*& data);          //can not re-instanciate a derived object that is not type Type
+    template<typename Type>                 if_PlainOldData<Type, void> Load(Type*& data, std::shared_ptr<void>* pShared = nullptr);    //can not re-instanciate a derived object that is not type Type
 
     template<typename Type, size_t count>   if_PlainOldData<Type, void> Save(Type(&array)[count]);  //array[] of POD types/struct (non-ints)
     template<typename Type, size_t count>   if_PlainOldData<Type, void> Load(Type(&array)[count]);
@@ -78,6 +134,9 @@ protected:
     template<typename Type>                 void    Save(std::unique_ptr<Type>& ptr);               //unique_ptr<>
     template<typename Type>                 void    Load(std::unique_ptr<Type>& ptr);
 
+    template<typename Type>                 void    Save(Lazy<Type>& lazy);                         //Lazy<>, a shared_ptr<> that
+    template<typename Type>                 void    Load(Lazy<Type>& lazy);                         //can load on first use
+
     template<typename Type>                 void    Save(std::vector<Type>& vector);                 //vector<>
     template<typename Type>                 void    Load(std::vector<Type>& vector);
 
@@ -96,44 +155,198 @@ protected:
     void                                            Save(std::string& str);                         //C++ string
     void                                            Load(std::string& str);
 
-    void                                            Save(void* pVoid, uint32 size);                 //blob
-    void                                            Load(void* pVoid, uint32 size);
+    void                                            Save(void* pVoid, size_t size);                 //blob
+    void                                            Load(void* pVoid, size_t size);
+
+    //In place loads: the view points into a memory backed source (SpanSource, MappedFileSource) and is
+    //valid while the source's bytes are, otherwise it points to a copy the archive keeps until the next load message
+    //starts (a Reset() while loading, or a switch back to loading), ReleaseViews() or its end, so a view loaded can be
+    //saved on (forwarded) by the same archive.  Session and stream archives that load message after message without a
+    //Reset() call ReleaseViews() once a message's views are done with, or the copies pile up for the connection.
+    //Same wire format as std::string / the blob, either side can use either.
+#if __cplusplus >= 201703L
+    void                                            Save(std::string_view& str);                    //string_view
+    void                                            Load(std::string_view& str);
+#endif
+#ifdef __cpp_lib_span
+    void                                            Save(std::span<const BYTE>& span);              //span of a blob
+    void                                            Load(std::span<const BYTE>& span);
+#endif
+    void                                            LoadView(const void*& pView, size_t& size);     //blob
+    void                                            ReleaseViews() { _viewCopies.clear(); }
 
 protected:
+    template<typename Type>                 if_IntegralType<Type, void> SaveFixed(Type& data);      //full width in any format (hashes)
+    template<typename Type>                 if_IntegralType<Type, void> LoadFixed(Type& data);
+    template<typename Type>                 if_IntegralType<Type, void> SaveItems(Type* pItems, size_t count);  //contiguous items, in bulk where possible
+    template<typename Type>                 if_IntegralType<Type, void> LoadItems(Type* pItems, size_t count);
+    template<typename Type>                 if_PlainOldData<Type, void> SaveItems(Type* pItems, size_t count);
+    template<typename Type>                 if_PlainOldData<Type, void> LoadItems(Type* pItems, size_t count);
+    template<typename Type>                 if_Compound<Type, void>     SaveItems(Type* pItems, size_t count);
+    template<typename Type>                 if_Compound<Type, void>     LoadItems(Type* pItems, size_t count);
+    template<typename Type>                 if_Trivial<Type, void>      LoadItems(std::vector<Type>& vector, uint64 size);
+    template<typename Type>                 if_Compound<Type, void>     LoadItems(std::vector<Type>& vector, uint64 size);
+    int64                                                               Remaining();                //bytes left to load, -1 when unknown
+    bool                                                                CountFits(uint64 count);    //count items of a byte or more can be left
+
     void                                            SaveType(SerializableBase* pObj);               //objId/hash
     const TypeInfo*                                 LoadType();
 
-    void                                            SaveDint(uint32 dint);                          //dynamic sized INT, 7 bits at a time (8th bit==stop-bit)
-    uint32                                          LoadDint();
-
-    int32                                           save(void* pData, uint32 size);                 //data source interface
-    int32                                           load(void* pData, uint32 size);
+    void                                            SaveDint(uint64 dint);                          //dynamic sized INT, 7 bits at a time (8th bit==stop-bit)
+    uint64                                          LoadDint();
+    void                                            SaveSint(int64 sint);                           //signed Dint, zigzag encoded (0, -1, 1, -2, ...)
+    int64                                           LoadSint();
+    void                                            SaveBytes(void* pData, size_t size);            //raw bytes, in pieces save/load can take
+    void                                            LoadBytes(void* pData, size_t size);
+    const BYTE*                                     ViewBytes(uint64 size);                         //in place, or a kept copy
+
+    //Global format pointers: [Dint id * 2 + body][type], the body follows in the archive that claimed the id
+    template<typename Type>                 if_Serializable<Type, void> SaveGlobal(Type* pObj);
+    template<typename Type>                 if_Serializable<Type, void> LoadGlobal(Type*& pObj, std::shared_ptr<void>* pShared, Lazy<Type>* pLazy = nullptr);
+    template<typename Type>                 if_PlainOldData<Type, void> SaveGlobal(Type* pObj);
+    template<typename Type>                 if_PlainOldData<Type, void> LoadGlobal(Type*& pObj, std::shared_ptr<void>* pShared);
+
+    //Delta format pointers: [Dint id], an id the peer already has.  Outside a record the id is followed by a snapshot of
+    //all it reaches, the records of the objects new to the peer or changed since it had them, then a 0:
+    //  {[Dint id * 2 + new][type, if new][Dint size][body, its pointers as ids]} [0]
+    //Ids are keyed by address, so each side holds every object it sent or loaded through a shared_ptr and no address is
+    //reused under an old id.  A raw pointer saves only to an object already held that way, any other is an error.  The
+    //table only grows: a long-lived connection watches DeltaObjects() and calls ResetDelta() on both ends to bound it.
+    template<typename Type>                 if_Serializable<Type, void> SaveDelta(Type* pObj, std::shared_ptr<void> shared);
+    template<typename Type>                 if_Serializable<Type, void> LoadDelta(Type*& pObj, std::shared_ptr<void>* pShared);
+    template<typename Type>                 if_PlainOldData<Type, void> SaveDelta(Type* pObj, std::shared_ptr<void>) { Save(pObj); }    //inline, per record
+
+    int32   save(void* pData, uint32 size)                                                          //data source interface (staged)
+    {
+        if(size > _saveBuffer.size() - _savePos)
+            return SaveBlock(pData, size);
+        std::memcpy(_saveBuffer.data() + _savePos, pData, size);
+        _savePos += size;
+        return int32(size);
+    }
+    int32   load(void* pData, uint32 size)
+    {
+        if(size > _loadEnd - _loadPos)
+            return LoadBlock(pData, size);
+        std::memcpy(pData, _pLoad + _loadPos, size);
+        _loadPos += size;
+        return int32(size);
+    }
 
 private:
+    int32   SaveBlock(void* pData, uint32 size);    //slow paths: spill/refill the staging buffers
+    int32   LoadBlock(void* pData, uint32 size);
+    bool    Stage(uint32 size);
+    bool    Drain();
+    bool    Fill();
+    void    Unload();
+    bool    Write(void* pData, uint32 size);
+    uint64  LoadDintSlow();
+
+    void    TagStream();
+    void    ResetTypes();
+    void    SerializeDeferred();
+
     IDataSource&    _source;
     Mode            _mode   = Unknown;
+    uint32          _format = Legacy;
+    bool            _bTag   = false;
+    uint32          _tagged = 0;                    //Session: modes (1 << Mode) already tagged
     uint32          _error  = 0;
 
-    enum { BIG_PRIME = 2038074743, };
-    void Hash(BYTE* pData, uint32 size) { while(size--) { _hash = (_hash + *pData++) * 0x0101; _hash ^= (_hash >> 3); } }
+    enum
+    {
+        VIEW_SIZE  = 0x40000000,                    //largest window borrowed from a memory backed source
+        CHUNK_SIZE = 0x00100000,                    //vector growth step when the source length is unknown
+        MAX_DINT   = 10,                            //bytes in the longest (64 bit) Dint
+    };
+    uint32              _bufferSize = BUFFER_SIZE;
+    std::vector<BYTE>   _saveBuffer;                //[0, _savePos) staged, [_saveHashed, _savePos) not yet hashed
+    uint32              _savePos    = 0;
+    uint32              _saveHashed = 0;
+    std::vector<BYTE>   _loadBuffer;
+    const BYTE*         _pLoad      = nullptr;      //_loadBuffer or a view lent by the source
+    uint32              _loadPos    = 0;            //[_loadPos, _loadEnd) read ahead, [_loadHashed, _loadPos) not yet hashed
+    uint32              _loadEnd    = 0;
+    uint32              _loadHashed = 0;
+    std::vector<std::vector<BYTE>>  _viewCopies;    //views loaded from a stream source, owned by the archive
+
+    enum { BIG_PRIME = 2038074743, CRC_SEED = 0xFFFFFFFF, TAG_MAGIC = 0xA7, };
+    uint32 HashType() const { return _format & HashMask; }
+    void Hash(BYTE* pData, uint32 size)
+    {
+        switch(HashType())
+        {
+        case Checksummed & HashMask:    _hash = Crc32c::Update(_hash, pData, size);                                 break;
+        case NoHash & HashMask:                                                                                     break;
+        default:                        while(size--) { _hash = (_hash + *pData++) * 0x0101; _hash ^= (_hash >> 3); } break;
+        }
+    }
+    uint32 HashSeed() const { return (HashType() == (Checksummed & HashMask)) ? uint32(CRC_SEED) : uint32(BIG_PRIME); }
+    void HashSaved()  { Hash(_saveBuffer.data() + _saveHashed, _savePos - _saveHashed); _saveHashed = _savePos; }
+    void HashLoaded() { Hash((BYTE*)_pLoad + _loadHashed, _loadPos - _loadHashed); _loadHashed = _loadPos; }
     uint32          _hash   = BIG_PRIME;
 
 private:
-    using ObjId  = uint32;
-    using TypeId = uint32;
+    using ObjId  = uint64;
+    using TypeId = uint64;
 
     enum { ID_NULL  = 1, ID_START = 2, };
     TypeId  _nextTypeId = ID_START;
     ObjId   _nextObjId  = ID_START;
 
-    std::map<const TypeInfo*, TypeId>   _mapTypeId;
-    std::map<void*, ObjId>              _mapObjId;
-
-    std::map<TypeId, const TypeInfo*>   _mapIdType;
-    std::map<ObjId, void*>              _mapIdObj;
-
-    using shared_base_ptr = std::shared_ptr<SerializableBase>;
-    std::map<void*, shared_base_ptr>    _mapObjShared;
+    HashMap<const TypeInfo*, TypeId>    _mapTypeId;
+    HashMap<void*, ObjId>               _mapObjId;
+
+    std::vector<const TypeInfo*>        _vecIdType;     //ids are dense, indexed by TypeId/ObjId
+    std::vector<void*>                  _vecIdObj;
+
+    std::vector<std::shared_ptr<void>>  _vecIdShared;   //owning shared_ptr by ObjId, once loaded into a shared_ptr
+
+    template<typename Type>
+    std::shared_ptr<void> Share(ObjId objId, Type* pObj)    //first shared_ptr to an object already loaded takes ownership
+    {
+        std::shared_ptr<void>& shared = _vecIdShared[objId];
+        if(!shared)
+            shared = std::shared_ptr<Type>(pObj, [](Type* p) { delete p; });     //the Archive's access, for SerializableBase
+        return shared;
+    }
+    std::shared_ptr<Arena>              _pArena;
+    std::shared_ptr<IdentityRegistry>   _pRegistry;
+    SerializableBase*                   _pRecordRoot  = nullptr;
+    std::vector<SerializableBase*>*     _pRecordQueue = nullptr;
+    template<typename Type> static bool IsOf(SerializableBase* pObj) { return pObj->IsOfType(Type::s_typeinfo.Hash()); }
+
+    struct DeltaEntry
+    {
+        std::shared_ptr<void>   shared;             //keeps the object, and its address, while the peer may refer to it
+        SerializableBase*       pObj  = nullptr;
+        uint64                  hash  = 0;          //of the record the peer has
+        uint64                  pass  = 0;          //last snapshot to reach it
+        bool                    bSent = false;      //the peer has it
+    };
+    struct DeltaState                               //kept across Reset(), both directions share the ids
+    {
+        HashMap<void*, ObjId>           ids;
+        HashMap<ObjId, DeltaEntry>      objs;
+        ObjId                           nextId = ID_START;     //past any id seen, the two sides take turns
+        uint64                          pass   = 0;
+        std::vector<SerializableBase*>  queue;      //reached by the snapshot being saved
+        MemorySource                    record;     //the record being saved
+        std::vector<BYTE>               bodies;     //the records being loaded
+    };
+    DeltaState                          _delta;
+    DeltaState*                         _pDelta  = &_delta;     //the outer archive's, in a record
+    bool                                _bRecord = false;       //saving/loading one record: pointers are ids only
+
+    ObjId   DeltaId(SerializableBase* pObj, std::shared_ptr<void> shared);    //pObj's id, queued once per snapshot, 0: not held
+    void    SaveSnapshot();
+    void    LoadSnapshot();
+    uint32  RecordFormat() const { return (_format & ~(HashMask | Iterative | Session)) | NoHash; }
+
+    uint32                              _depth    = 0;  //nested Serialize/<</>> calls
+    std::vector<SerializableBase*>      _deferred;      //Iterative work queue, [_deferPos, end) still to serialize
+    size_t                              _deferPos = 0;
 };
 
 }//namespace Serialize
@@ -6,12 +6,14 @@ namespace Serialize {
 template<typename Type>
 Archive& Archive::Serialize(Type& obj)
 {
+    Enter();
     switch(_mode)
     {
     case SaveArchive:   Save(obj);  break;
     case LoadArchive:   Load(obj);  break;
     default:            Error();    break;
     }
+    Leave();
     return *this;
 }
 
@@ -19,14 +21,18 @@ template<typename Type>
 Archive& Archive::operator<<(Type& obj)
 {
     SetSave();
+    Enter();
     Save(obj);
+    Leave();
     return *this;
 }
 template<typename Type>
 Archive& Archive::operator>>(Type& obj)
 {
     SetLoad();
+    Enter();
     Load(obj);
+    Leave();
     return *this;
 }
 
@@ -51,6 +57,10 @@ template<typename Type>
 if_Serializable<Type, void> Archive::Save(Type*& pObj)
 {
     if(IsError()) return;
+    if(IsFormat(Global))
+        return SaveGlobal(pObj);
+    if(IsFormat(Delta))
+        return SaveDelta(pObj, nullptr);
     ObjId& objId = _mapObjId[pObj];
     if(objId)
     {
@@ -60,33 +70,152 @@ if_Serializable<Type, void> Archive::Save(Type*& pObj)
     objId = _nextObjId++;
     SaveDint(objId);
     SaveType(pObj);
-    pObj->Serialize(*this);
+    if(IsFormat(Iterative))
+        Defer(pObj);
+    else
+        pObj->Serialize(*this);
 }
 template<typename Type>
-if_Serializable<Type, void> Archive::Load(Type*& pObj)
+if_Serializable<Type, void> Archive::Load(Type*& pObj, std::shared_ptr<void>* pShared)   //pShared: owned by a shared_ptr, create it with its control block
 {
     if(IsError()) return;
+    if(IsFormat(Global))
+        return LoadGlobal(pObj, pShared);
+    if(IsFormat(Delta))
+        return LoadDelta(pObj, pShared);
     ObjId objId = LoadDint();
-    Type*& pNew = (Type*&)_mapIdObj[objId];
-    if(!pNew && (objId != ID_NULL))
+    Type* pNew = nullptr;
+    if(objId < _vecIdObj.size())
     {
+        pNew = (Type*)_vecIdObj[objId];
+        if(pShared && pNew)
+            *pShared = Share(objId, pNew);
+    }
+    else
+    {
+        if(objId != _vecIdObj.size())   //new ids are sequential
+            return Error();
         const TypeInfo* pTypeInfo = LoadType();
         if(!pTypeInfo)
             return Error();
-        HASH hash = Type::s_typeinfo.Hash();
-        pNew = (Type*)pTypeInfo->Create();
-        if(!pNew->IsOfType(hash))
+        if(pShared)
         {
-            delete pNew;    //pNew is not of type Type.
-            return Error();
+            std::shared_ptr<SerializableBase> ptr = pTypeInfo->CreateShared(_pArena);
+            if(!IsOf<Type>(ptr.get()))
+                return Error();     //ptr is not of type Type.
+            pNew = (Type*)ptr.get();
+            *pShared = std::static_pointer_cast<Type>(std::move(ptr));
+        }
+        else
+        {
+            pNew = (Type*)pTypeInfo->Create();
+            if(!IsOf<Type>(pNew))
+            {
+                delete pNew;    //pNew is not of type Type.
+                return Error();
+            }
         }
-        pNew->Serialize(*this);
+        _vecIdObj.push_back(pNew);
+        _vecIdShared.push_back(pShared ? *pShared : nullptr);
+        if(IsFormat(Iterative))
+            Defer(pNew);
+        else
+            pNew->Serialize(*this);
     }
     if(pObj)
         delete pObj;
     pObj = pNew;
 }
 
+template<typename Type>
+if_Serializable<Type, void> Archive::SaveGlobal(Type* pObj)
+{
+    if(!_pRegistry) return Error();
+    bool bFirst = false;
+    ObjId objId = pObj ? _pRegistry->Claim(pObj, bFirst) : ObjId(ID_NULL);
+    bool bBody = bFirst;
+    if(_pRecordQueue)           //an IndexedWriter record, only its root is inline
+    {
+        bBody = pObj && (pObj == _pRecordRoot);
+        if(bBody)
+            _pRecordRoot = nullptr;     //once, a cycle back to it is a reference
+        if(bFirst && !bBody)
+            _pRecordQueue->push_back(pObj);
+    }
+    SaveDint(objId * 2 + (bBody ? 1 : 0));
+    if(!pObj)
+        return;
+    SaveType(pObj);
+    if(!bBody)
+        return;
+    if(IsFormat(Iterative))
+        Defer(pObj);
+    else
+        pObj->Serialize(*this);
+}
+template<typename Type>
+if_Serializable<Type, void> Archive::LoadGlobal(Type*& pObj, std::shared_ptr<void>* pShared, Lazy<Type>* pLazy)    //pObj does not own, the registry does
+{
+    if(!_pRegistry) return Error();
+    uint64 dint  = LoadDint();
+    ObjId  objId = dint / 2;
+    bool   bBody = (dint & 1) != 0;
+    pObj = nullptr;
+    if((objId == ID_NULL) && !bBody)
+        return;
+    if(objId < ID_START)
+        return Error();
+    const TypeInfo* pTypeInfo = LoadType();
+    if(!pTypeInfo)
+        return Error();
+    if(pLazy && !bBody)         //the body is elsewhere, fetched when the Lazy<> is first used
+        return pLazy->Defer(_pRegistry, objId);
+    std::shared_ptr<void> shared = _pRegistry->Acquire(objId, bBody, [&]{ return std::shared_ptr<void>(pTypeInfo->CreateShared(_pArena)); });
+    SerializableBase* pBase = (SerializableBase*)shared.get();
+    if(!pBase || (pBase->GetTypeInfo() != pTypeInfo) || !IsOf<Type>(pBase))
+        return Error();     //second body, or not of type Type
+    pObj = (Type*)pBase;
+    if(pShared)
+        *pShared = std::shared_ptr<Type>(shared, pObj);
+    if(!bBody)
+        return;
+    if(IsFormat(Iterative))
+        Defer(pObj);
+    else
+        pObj->Serialize(*this);
+}
+
+template<typename Type>
+if_Serializable<Type, void> Archive::SaveDelta(Type* pObj, std::shared_ptr<void> shared)
+{
+    if(!_bRecord)
+        _pDelta->pass++;    //a new snapshot, from pObj
+    ObjId objId = pObj ? DeltaId(pObj, std::move(shared)) : ObjId(ID_NULL);
+    if(!objId)
+        return Error();     //a raw pointer to an object nothing holds
+    SaveDint(objId);
+    if(!_bRecord)
+        SaveSnapshot();
+}
+template<typename Type>
+if_Serializable<Type, void> Archive::LoadDelta(Type*& pObj, std::shared_ptr<void>* pShared)    //pObj does not own, the archive does
+{
+    ObjId objId = LoadDint();
+    if(!_bRecord)
+        LoadSnapshot();
+    pObj = nullptr;
+    if(IsError() || (objId == ID_NULL))
+        return;
+    DeltaEntry* pEntry = _pDelta->objs.find(objId);
+    if(!pEntry || !pEntry->pObj || !IsOf<Type>(pEntry->pObj))
+        return Error();     //unknown id, or not of type Type
+    if(pShared && !pEntry->shared)
+        return Error();     //saved from a raw pointer, nothing to share ownership with
+    pObj = (Type*)pEntry->pObj;
+    if(pShared)
+        *pShared = std::shared_ptr<Type>(pEntry->shared, pObj);
+}
+
 template<typename Type, size_t count>
 if_Serializable<Type, void> Archive::Save(Type(&array)[count])      //array[] of serializable derived object
 {
@@ -100,7 +229,7 @@ template<typename Type, size_t count>
 if_Serializable<Type, void> Archive::Load(Type(&array)[count])
 {
     if(IsError()) return;
-    uint32 arcCount = LoadDint();
+    uint64 arcCount = LoadDint();
     if(arcCount != count)
         return Error();
     const TypeInfo* pTypeInfo = LoadType();
@@ -127,6 +256,8 @@ template<typename Type>
 if_PlainOldData<Type, void> Archive::Save(Type*& pObj)
 {
     if(IsError()) return;
+    if(IsFormat(Global))
+        return SaveGlobal(pObj);
     ObjId& objId = _mapObjId[pObj];
     if(objId)
     {
@@ -138,14 +269,33 @@ if_PlainOldData<Type, void> Archive::Save(Type*& pObj)
     Save(*pObj);
 }
 template<typename Type>
-if_PlainOldData<Type, void> Archive::Load(Type*& pObj)
+if_PlainOldData<Type, void> Archive::Load(Type*& pObj, std::shared_ptr<void>* pShared)
 {
     if(IsError()) return;
+    if(IsFormat(Global))
+        return LoadGlobal(pObj, pShared);
     ObjId objId = LoadDint();
-    Type*& pNew = (Type*&)_mapIdObj[objId];
-    if(!pNew && (objId != ID_NULL))
+    Type* pNew = nullptr;
+    if(objId < _vecIdObj.size())
     {
-        pNew = new Type;
+        pNew = (Type*)_vecIdObj[objId];
+        if(pShared && pNew)
+            *pShared = Share(objId, pNew);
+    }
+    else
+    {
+        if(objId != _vecIdObj.size())   //new ids are sequential
+            return Error();
+        if(pShared)
+        {
+            std::shared_ptr<Type> ptr = _pArena ? std::allocate_shared<Type>(ArenaAllocator<Type>(_pArena)) : std::make_shared<Type>();
+            pNew = ptr.get();
+            *pShared = std::move(ptr);
+        }
+        else
+            pNew = new Type;
+        _vecIdObj.push_back(pNew);
+        _vecIdShared.push_back(pShared ? *pShared : nullptr);
         Load(*pNew);
     }
     if(pObj != pNew)
@@ -156,6 +306,41 @@ if_PlainOldData<Type, void> Archive::Load(Type*& pObj)
     }
 }
 
+template<typename Type>
+if_PlainOldData<Type, void> Archive::SaveGlobal(Type* pObj)
+{
+    if(!_pRegistry) return Error();
+    bool bFirst = false;
+    ObjId objId = pObj ? _pRegistry->Claim(pObj, bFirst) : ObjId(ID_NULL);
+    SaveDint(objId * 2 + (bFirst ? 1 : 0));
+    if(bFirst)
+        Save(*pObj);
+}
+template<typename Type>
+if_PlainOldData<Type, void> Archive::LoadGlobal(Type*& pObj, std::shared_ptr<void>* pShared)
+{
+    if(!_pRegistry) return Error();
+    uint64 dint  = LoadDint();
+    ObjId  objId = dint / 2;
+    bool   bBody = (dint & 1) != 0;
+    pObj = nullptr;
+    if((objId == ID_NULL) && !bBody)
+        return;
+    if(objId < ID_START)
+        return Error();
+    std::shared_ptr<void> shared = _pRegistry->Acquire(objId, bBody, [&]
+    {
+        return std::shared_ptr<void>(_pArena ? std::allocate_shared<Type>(ArenaAllocator<Type>(_pArena)) : std::make_shared<Type>());
+    });
+    if(!shared)
+        return Error();
+    pObj = (Type*)shared.get();
+    if(pShared)
+        *pShared = shared;
+    if(bBody)
+        Load(*pObj);
+}
+
 template<typename Type, size_t count>
 if_PlainOldData<Type, void> Archive::Save(Type(&array)[count])      //array[] of POD types (non-ints)
 {
@@ -167,7 +352,7 @@ template<typename Type, size_t count>
 if_PlainOldData<Type, void> Archive::Load(Type(&array)[count])
 {
     if(IsError()) return;
-    uint32 arcCount = LoadDint();
+    uint64 arcCount = LoadDint();
     if(arcCount > count)
         return Error();
     load(&array, sizeof(array));
@@ -175,6 +360,39 @@ if_PlainOldData<Type, void> Archive::Load(Type(&array)[count])
 
 template<typename Type>
 if_IntegralType<Type, void> Archive::Save(Type& data)
+{
+    if(IsError()) return;
+    if(!IsCompact<Type>())
+        return SaveFixed(data);
+    if(std::is_signed<Type>::value)
+        SaveSint(int64(data));
+    else
+        SaveDint(uint64(data));
+}
+template<typename Type>
+if_IntegralType<Type, void> Archive::Load(Type& data)
+{
+    if(IsError()) return;
+    if(!IsCompact<Type>())
+        return LoadFixed(data);
+    if(std::is_signed<Type>::value)
+    {
+        int64 sint = LoadSint();
+        if((sint < int64(std::numeric_limits<Type>::min())) || (sint > int64(std::numeric_limits<Type>::max())))
+            return Error();
+        data = Type(sint);
+    }
+    else
+    {
+        uint64 dint = LoadDint();
+        if(dint > uint64(std::numeric_limits<Type>::max()))
+            return Error();
+        data = Type(dint);
+    }
+}
+
+template<typename Type>
+if_IntegralType<Type, void> Archive::SaveFixed(Type& data)
 {
     if(IsError()) return;
     using unType = typename std::make_unsigned<Type>::type;
@@ -183,7 +401,7 @@ if_IntegralType<Type, void> Archive::Save(Type& data)
     save((void*)&un_nbo, sizeof(Type));
 }
 template<typename Type>
-if_IntegralType<Type, void> Archive::Load(Type& data)
+if_IntegralType<Type, void> Archive::LoadFixed(Type& data)
 {
     if(IsError()) return;
     using unType = typename std::make_unsigned<Type>::type;
@@ -198,18 +416,16 @@ if_IntegralType<Type, void> Archive::Save(Type(&array)[count])      //array[] of
 {
     if(IsError()) return;
     SaveDint(count);
-    for(auto & item : array)
-        Save(item);
+    SaveItems(array, count);
 }
 template<typename Type, size_t count>
 if_IntegralType<Type, void> Archive::Load(Type(&array)[count])
 {
     if(IsError()) return;
-    uint32 arcCount = LoadDint();
+    uint64 arcCount = LoadDint();
     if(arcCount > count)
         return Error();
-    for(auto & item : array)
-        Load(item);
+    LoadItems(array, count);
 }
 
 template<size_t count>
@@ -229,7 +445,7 @@ template<size_t count>
 void Archive::Load(char(&sz)[count])
 {
     if(IsError()) return;
-    uint32 size = LoadDint();
+    uint64 size = LoadDint();
     if(count <= size)
         return Error();
     if(size)
@@ -242,6 +458,8 @@ void Archive::Save(std::shared_ptr<Type>& ptr)
 {
     if(IsError()) return;
     Type* pType = ptr.get();
+    if(IsFormat(Delta))
+        return SaveDelta(pType, ptr);     //kept while the peer may refer to it
     Save(pType);
 }
 template<typename Type>
@@ -249,14 +467,10 @@ void Archive::Load(std::shared_ptr<Type>& ptr)
 {
     if(IsError()) return;
     Type* pType = nullptr;
-    Load(pType);
-    if(pType)
-    {
-        std::shared_ptr<Type>& type = (std::shared_ptr<Type>&)_mapObjShared[pType];
-        if(!type)
-            type = std::shared_ptr<Type>(pType);
-        ptr = type;
-    }
+    std::shared_ptr<void> shared;
+    Load(pType, &shared);
+    if(!IsError())
+        ptr = pType ? std::static_pointer_cast<Type>(std::move(shared)) : nullptr;     //a null replaces what was there (Delta patches)
 }
 
 template<typename Type>
@@ -270,33 +484,50 @@ template<typename Type>
 void Archive::Load(std::unique_ptr<Type>& ptr)
 {
     if(IsError()) return;
+    if(IsFormat(Global) || IsFormat(Delta))
+        return Error();     //the registry owns Global objects, the archive Delta ones
     Type* pType = nullptr;
     Load(pType);
     ptr = std::unique_ptr<Type>(pType);
 }
 
+template<typename Type>
+void Archive::Save(Lazy<Type>& lazy)
+{
+    if(IsError()) return;
+    std::shared_ptr<Type> ptr = lazy.Get();
+    Save(ptr);
+}
+template<typename Type>
+void Archive::Load(Lazy<Type>& lazy)
+{
+    if(IsError()) return;
+    lazy = Lazy<Type>();
+    Type* pType = nullptr;
+    std::shared_ptr<void> shared;
+    if(IsFormat(Global))
+        LoadGlobal(pType, &shared, &lazy);
+    else
+        Load(pType, &shared);
+    if(pType)
+        lazy = Lazy<Type>(std::static_pointer_cast<Type>(std::move(shared)));
+}
+
 template<typename Type>
 void Archive::Save(std::vector<Type>& vector)
 {
     if(IsError()) return;
-    uint32 size = uint32(vector.size());
+    size_t size = vector.size();
     SaveDint(size);
-    for(Type& item : vector)
-        Save(item);
+    SaveItems(vector.data(), size);
 }
 template<typename Type>
 void Archive::Load(std::vector<Type>& vector)
 {
     if(IsError()) return;
-    uint32 size = LoadDint();
+    uint64 size = LoadDint();
     vector.clear();
-    vector.reserve(size);
-    for(uint32 i = 0; i < size; i++)
-    {
-        Type type = {};;
-        Load(type);
-        vector.push_back(type);
-    }
+    LoadItems(vector, size);
 }
 
 template<typename Type, size_t count>
@@ -304,25 +535,23 @@ void Archive::Save(std::array<Type, count>& array)
 {
     if(IsError()) return;
     SaveDint(count);
-    for(Type& item : array)
-        Save(item);
+    SaveItems(array.data(), count);
 }
 template<typename Type, size_t count>
 void Archive::Load(std::array<Type, count>& array)
 {
     if(IsError()) return;
-    uint32 arcCount = LoadDint();
+    uint64 arcCount = LoadDint();
     if(arcCount != count)
         return Error();
-    for(Type& item : array)
-        Load(item);
+    LoadItems(array.data(), count);
 }
 
 template<typename Type>
 void Archive::Save(std::list<Type>& list)
 {
     if(IsError()) return;
-    uint32 size = uint32(list.size());
+    size_t size = list.size();
     SaveDint(size);
     for(Type& item : list)
         Save(item);
@@ -331,9 +560,11 @@ template<typename Type>
 void Archive::Load(std::list<Type>& list)
 {
     if(IsError()) return;
-    uint32 size = LoadDint();
+    uint64 size = LoadDint();
     list.clear();
-    for(uint32 i = 0; i < size; i++)
+    if(!CountFits(size))
+        return;
+    for(uint64 i = 0; (i < size) && !IsError(); i++)
     {
         Type type = {};
         Load(type);
@@ -341,11 +572,99 @@ void Archive::Load(std::list<Type>& list)
     }
 }
 
+template<typename Type>
+if_IntegralType<Type, void> Archive::SaveItems(Type* pItems, size_t count)    //byte order straight into the staging buffer
+{
+    while(count && !IsError() && !IsCompact<Type>())
+    {
+        size_t room = (_saveBuffer.size() - _savePos) / sizeof(Type);
+        if(!room)
+        {
+            if(!Stage(sizeof(Type)))
+                break;
+            continue;
+        }
+        size_t items = (room < count) ? room : count;
+        ByteOrder<Type>(_saveBuffer.data() + _savePos, (const BYTE*)pItems, items);
+        _savePos += uint32(items * sizeof(Type));
+        pItems   += items;
+        count    -= items;
+    }
+    for(; count && !IsError(); count--)     //unbuffered or Compact
+        Save(*pItems++);
+}
+template<typename Type>
+if_IntegralType<Type, void> Archive::LoadItems(Type* pItems, size_t count)
+{
+    if(IsCompact<Type>())
+    {
+        for(; count && !IsError(); count--)
+            Load(*pItems++);
+        return;
+    }
+    LoadBytes(pItems, count * sizeof(Type));
+    ByteOrder<Type>((BYTE*)pItems, (const BYTE*)pItems, count);
+}
+
+template<typename Type>
+if_PlainOldData<Type, void> Archive::SaveItems(Type* pItems, size_t count)
+{
+    SaveBytes(pItems, count * sizeof(Type));
+}
+template<typename Type>
+if_PlainOldData<Type, void> Archive::LoadItems(Type* pItems, size_t count)
+{
+    LoadBytes(pItems, count * sizeof(Type));
+}
+
+template<typename Type>
+if_Compound<Type, void> Archive::SaveItems(Type* pItems, size_t count)
+{
+    for(; count; count--)
+        Save(*pItems++);
+}
+template<typename Type>
+if_Compound<Type, void> Archive::LoadItems(Type* pItems, size_t count)
+{
+    for(; count; count--)
+        Load(*pItems++);
+}
+
+template<typename Type>
+if_Trivial<Type, void> Archive::LoadItems(std::vector<Type>& vector, uint64 size)     //resize once and load the payload in bulk
+{
+    static_assert(!std::is_pointer<Type>::value, "pointer items load one at a time");
+    int64 remaining = Remaining();
+    uint64 itemSize = (is_IntegralType<Type> && IsCompact<Type>()) ? 1 : sizeof(Type);     //smallest a saved item can be
+    if((size > SIZE_MAX / sizeof(Type)) || ((remaining >= 0) && (size * itemSize > uint64(remaining))))
+        return Error();
+    size_t chunk = ((remaining >= 0) ? VIEW_SIZE : CHUNK_SIZE) / sizeof(Type);  //unknown length, grow as the data arrives
+    for(size_t done = 0; (done < size) && !IsError(); done += chunk)
+    {
+        size_t items = ((size - done) < chunk) ? (size - done) : chunk;
+        vector.resize(done + items);
+        LoadItems(vector.data() + done, items);
+    }
+}
+template<typename Type>
+if_Compound<Type, void> Archive::LoadItems(std::vector<Type>& vector, uint64 size)
+{
+    if(!CountFits(size))
+        return;
+    vector.reserve(size_t((size < CHUNK_SIZE) ? size : uint64(CHUNK_SIZE)));   //size is untrusted, grow past a chunk as items arrive
+    for(uint64 i = 0; (i < size) && !IsError(); i++)
+    {
+        Type type = {};
+        Load(type);
+        vector.push_back(type);
+    }
+}
+
 template<typename Key, typename Value>
 void Archive::Save(std::map<Key, Value>& map)
 {
     if(IsError()) return;
-    uint32 size = uint32(map.size());
+    size_t size = map.size();
     SaveDint(size);
     for(auto& pair : map)
     {
@@ -357,9 +676,11 @@ template<typename Key, typename Value>
 void Archive::Load(std::map<Key, Value>& map)
 {
     if(IsError()) return;
-    uint32 size = LoadDint();
+    uint64 size = LoadDint();
     map.clear();
-    for(uint32 i = 0; i < size; i++)
+    if(!CountFits(size))
+        return;
+    for(uint64 i = 0; (i < size) && !IsError(); i++)
     {
         Key key = {};
         Value value = {};
@@ -369,6 +690,9 @@ void Archive::Load(std::map<Key, Value>& map)
     }
 }
 
+template<>
+inline bool Archive::IsOf<SerializableBase>(SerializableBase*) { return true; }    //records loaded without a static type
+
 #if __cplusplus < 201703L
 #define constexpr
 #endif
@@ -411,5 +735,51 @@ if_IntegralType<Type, Type> ByteOrder(Type data)
 #undef constexpr
 #endif
 
+#if defined(__SSSE3__) || defined(__AVX2__)
+inline __m128i ByteOrderMask(size_t size)     //pshufb control reversing each size byte lane
+{
+    alignas(16) BYTE mask[16];
+    for(size_t i = 0; i < sizeof(mask); i++)
+        mask[i] = BYTE((i / size) * size + (size - 1 - i % size));
+    return _mm_load_si128((const __m128i*)mask);
+}
+#endif
+
+template<typename Type>
+if_IntegralType<Type, void> ByteOrder(BYTE* pDest, const BYTE* pSrc, size_t count)
+{
+    static const uint32 i = 1;
+    if((sizeof(Type) == 1) || ((*(BYTE*)&i) != 1))     //already in network order
+    {
+        if(pDest != pSrc)
+            std::memcpy(pDest, pSrc, count * sizeof(Type));
+        return;
+    }
+    size_t n = 0;
+#if defined(__AVX2__)
+    const __m256i mask256 = _mm256_broadcastsi128_si256(ByteOrderMask(sizeof(Type)));
+    for(; n + 32 / sizeof(Type) <= count; n += 32 / sizeof(Type))
+    {
+        __m256i data = _mm256_loadu_si256((const __m256i*)(pSrc + n * sizeof(Type)));
+        _mm256_storeu_si256((__m256i*)(pDest + n * sizeof(Type)), _mm256_shuffle_epi8(data, mask256));
+    }
+#endif
+#if defined(__SSSE3__) || defined(__AVX2__)
+    const __m128i mask = ByteOrderMask(sizeof(Type));
+    for(; n + 16 / sizeof(Type) <= count; n += 16 / sizeof(Type))
+    {
+        __m128i data = _mm_loadu_si128((const __m128i*)(pSrc + n * sizeof(Type)));
+        _mm_storeu_si128((__m128i*)(pDest + n * sizeof(Type)), _mm_shuffle_epi8(data, mask));
+    }
+#endif
+    for(; n < count; n++)
+    {
+        Type data;
+        std::memcpy(&data, pSrc + n * sizeof(Type), sizeof(Type));
+        data = ByteOrder(data);
+        std::memcpy(pDest + n * sizeof(Type), &data, sizeof(Type));
+    }
+}
+
 }//namespace Serialize
 
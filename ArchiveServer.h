@@ -0,0 +1,337 @@
+#pragma once
+
+#ifdef __linux__
+
+#include <map>
+#include <deque>
+#include <mutex>
+#include <atomic>
+#include <thread>
+#include <memory>
+#include <functional>
+
+#include <fcntl.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+
+#include "FrameSource.h"
+#include "ThreadPool.h"
+
+namespace Serialize {
+
+//Event driven server for FrameSource framed messages.  One thread runs epoll over the listener and every connection,
+//reading and writing without blocking.  Each complete request is handed to Handler on the thread pool, a connection's
+//requests are handled one at a time and in order, a non empty reply is framed and sent back.  A client that half
+//closes (shutdown(SHUT_WR)) after its requests still gets every reply, the connection is dropped after the last.
+//The client side is a FrameSource over a SocketSource.
+class ArchiveServer
+{
+public:
+    using Handler = std::function<void(std::vector<BYTE>& request, std::vector<BYTE>& reply)>;
+
+    ArchiveServer(Handler handler, uint32 threads = 0) : _handler(std::move(handler)), _pool(threads) {}
+    ArchiveServer(const ArchiveServer&) = delete;
+    ArchiveServer& operator=(const ArchiveServer&) = delete;
+    ~ArchiveServer() { Stop(); }
+
+    bool Start(short port)
+    {
+        SOCKADDR_IN sa = {};
+        sa.sin_family      = AF_INET;
+        sa.sin_port        = htons(port);
+        sa.sin_addr.s_addr = INADDR_ANY;
+        int opt = 1;
+        _listen = ::socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, IPPROTO_TCP);
+        _epoll  = ::epoll_create1(EPOLL_CLOEXEC);
+        _wake   = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        if((_listen < 0) || (_epoll < 0) || (_wake < 0))
+            return Close(), false;
+        ::setsockopt(_listen, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
+        if(::bind(_listen, (SOCKADDR*)&sa, sizeof(sa)) || ::listen(_listen, SOMAXCONN))
+            return Close(), false;
+        Watch(_listen, EPOLLIN, EPOLL_CTL_ADD);
+        Watch(_wake, EPOLLIN, EPOLL_CTL_ADD);
+        _bStop = false;
+        _thread = std::thread([this]{ Run(); });
+        return true;
+    }
+    void Stop()
+    {
+        if(!_thread.joinable())
+            return;
+        _bStop = true;
+        Wake();
+        _thread.join();
+        while(_pending)         //handlers still running post their replies through _wake
+            std::this_thread::yield();
+        Close();
+    }
+
+    uint64 Messages() const    { return _messages; }        //requests handled
+    uint32 Connections() const { return _connections; }
+
+private:
+    enum { READ_SIZE = 64 * 1024, };
+
+    struct Connection
+    {
+        int                             fd = -1;
+        std::vector<BYTE>               in;             //bytes read, [inPos, inEnd) not parsed yet
+        size_t                          inPos = 0;
+        size_t                          inEnd = 0;
+        std::deque<std::vector<BYTE>>   requests;       //complete, waiting for the handler
+        bool                            bBusy = false;  //a request is on the pool
+        std::vector<BYTE>               out;            //framed replies, [outPos, out.size()) not sent yet
+        size_t                          outPos = 0;
+        uint32                          events = 0;     //polled for, 0: not in the epoll set
+        bool                            bEnd = false;   //the peer sent all it will, replies still go out
+        bool                            bClosing = false;   //failed, drop without replying
+    };
+    struct Reply
+    {
+        int                 fd;
+        uint64              serial;     //tells a reused fd from the connection the request came from
+        std::vector<BYTE>   data;
+    };
+
+    Handler                                 _handler;
+    ThreadPool                              _pool;
+    std::thread                             _thread;
+    std::atomic<bool>                       _bStop{true};
+    int                                     _listen = -1;
+    int                                     _epoll  = -1;
+    int                                     _wake   = -1;
+    std::map<int, std::pair<uint64, Connection>> _conns;    //by fd, with a serial number
+    uint64                                  _serial = 0;
+    std::mutex                              _mutex;         //guards _replies, filled by the pool
+    std::vector<Reply>                      _replies;
+    std::atomic<uint64>                     _messages{0};
+    std::atomic<uint32>                     _connections{0};
+    std::atomic<uint32>                     _pending{0};    //requests on the pool
+
+    void Run()
+    {
+        epoll_event events[64];
+        while(!_bStop)
+        {
+            int count = ::epoll_wait(_epoll, events, 64, -1);
+            for(int i = 0; i < count; i++)
+            {
+                int fd = events[i].data.fd;
+                if(fd == _listen)
+                    Accept();
+                else if(fd == _wake)
+                    Replies();
+                else
+                {
+                    auto it = _conns.find(fd);
+                    if(it == _conns.end())
+                        continue;
+                    Connection& conn = it->second.second;
+                    if(events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR))
+                        Read(conn);
+                    if(!conn.bClosing && (events[i].events & EPOLLOUT))
+                        Write(conn);
+                    if(conn.bClosing && !conn.bBusy)
+                        Drop(fd);
+                    else if(conn.bClosing)          //keep the fd until its reply is back, but stop polling it
+                        ::epoll_ctl(_epoll, EPOLL_CTL_DEL, fd, nullptr), conn.events = 0;
+                    else if(IsDone(conn))
+                        Drop(fd);
+                }
+            }
+        }
+        std::vector<int> fds;
+        for(auto& conn : _conns)
+            fds.push_back(conn.first);
+        for(int fd : fds)
+            Drop(fd);
+    }
+
+    void Accept()
+    {
+        for(;;)
+        {
+            int fd = ::accept4(_listen, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+            if(fd < 0)
+                return;
+            int opt = 1;
+            ::setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &opt, sizeof(opt));
+            auto& entry = _conns[fd];
+            entry.first  = ++_serial;
+            entry.second = Connection();
+            entry.second.fd = fd;
+            Poll(entry.second);
+            _connections++;
+        }
+    }
+    void Read(Connection& conn)
+    {
+        for(;;)
+        {
+            if(conn.in.size() - conn.inEnd < READ_SIZE)
+                conn.in.resize(conn.inEnd + READ_SIZE);
+            ssize_t ret = ::recv(conn.fd, conn.in.data() + conn.inEnd, READ_SIZE, 0);
+            if(ret > 0)
+            {
+                conn.inEnd += size_t(ret);
+                continue;
+            }
+            if((ret < 0) && ((errno == EAGAIN) || (errno == EWOULDBLOCK)))
+                break;
+            if((ret < 0) && (errno == EINTR))
+                continue;
+            if(ret == 0)
+                conn.bEnd = true;       //closed by the peer, at least its sending side
+            else
+                conn.bClosing = true;   //failed
+            break;
+        }
+        while(conn.inEnd - conn.inPos >= FrameSource::HEADER_SIZE)     //split off the complete messages
+        {
+            uint32 size = FrameSource::GetSize(conn.in.data() + conn.inPos);
+            if(size > FrameSource::MAX_MESSAGE)
+            {
+                conn.bClosing = true;
+                break;
+            }
+            if(conn.inEnd - conn.inPos - FrameSource::HEADER_SIZE < size)
+                break;
+            const BYTE* pPayload = conn.in.data() + conn.inPos + FrameSource::HEADER_SIZE;
+            conn.requests.emplace_back(pPayload, pPayload + size);
+            conn.inPos += FrameSource::HEADER_SIZE + size;
+        }
+        std::memmove(conn.in.data(), conn.in.data() + conn.inPos, conn.inEnd - conn.inPos);     //keep a partial message
+        conn.inEnd -= conn.inPos;
+        conn.inPos  = 0;
+        if(conn.bEnd && !conn.bClosing)
+            Poll(conn);                 //nothing more to read, stop polling for it
+        Dispatch(conn);
+    }
+    void Dispatch(Connection& conn)
+    {
+        if(conn.bBusy || conn.bClosing || conn.requests.empty())
+            return;
+        conn.bBusy = true;
+        auto pRequest = std::make_shared<std::vector<BYTE>>(std::move(conn.requests.front()));
+        conn.requests.pop_front();
+        int fd = conn.fd;
+        uint64 serial = _conns[fd].first;
+        _pending++;
+        _pool.Submit([this, pRequest, fd, serial]
+        {
+            Reply reply = { fd, serial, {} };
+            _handler(*pRequest, reply.data);
+            _messages++;
+            {
+                std::lock_guard<std::mutex> lock(_mutex);
+                _replies.push_back(std::move(reply));
+            }
+            Wake();
+            _pending--;
+        });
+    }
+    void Replies()      //handled requests, back on the event thread
+    {
+        uint64 value;
+        while(::read(_wake, &value, sizeof(value)) > 0)
+            ;
+        std::vector<Reply> replies;
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            replies.swap(_replies);
+        }
+        for(Reply& reply : replies)
+        {
+            auto it = _conns.find(reply.fd);
+            if((it == _conns.end()) || (it->second.first != reply.serial))
+                continue;
+            Connection& conn = it->second.second;
+            conn.bBusy = false;
+            if(!reply.data.empty() && !conn.bClosing)
+            {
+                size_t size = conn.out.size();
+                conn.out.resize(size + FrameSource::HEADER_SIZE);
+                FrameSource::PutSize(conn.out.data() + size, uint32(reply.data.size()));
+                conn.out.insert(conn.out.end(), reply.data.begin(), reply.data.end());
+                Write(conn);
+            }
+            if(conn.bClosing)
+                Drop(conn.fd);
+            else
+            {
+                Dispatch(conn);
+                if(IsDone(conn))
+                    Drop(conn.fd);
+            }
+        }
+    }
+    void Write(Connection& conn)
+    {
+        while(conn.outPos < conn.out.size())
+        {
+            ssize_t ret = ::send(conn.fd, conn.out.data() + conn.outPos, conn.out.size() - conn.outPos, MSG_NOSIGNAL);
+            if(ret > 0)
+                conn.outPos += size_t(ret);
+            else if((ret < 0) && (errno == EINTR))
+                continue;
+            else if((ret < 0) && ((errno == EAGAIN) || (errno == EWOULDBLOCK)))
+            {
+                Poll(conn);         //finish when the socket drains
+                return;
+            }
+            else
+            {
+                conn.bClosing = true;
+                return;
+            }
+        }
+        conn.out.clear();
+        conn.outPos = 0;
+        Poll(conn);
+    }
+    bool IsDone(const Connection& conn) const   //the peer's end reached and everything it asked for answered
+    {
+        return conn.bEnd && !conn.bBusy && conn.requests.empty() && (conn.outPos == conn.out.size());
+    }
+    void Drop(int fd)
+    {
+        ::epoll_ctl(_epoll, EPOLL_CTL_DEL, fd, nullptr);
+        ::close(fd);
+        _conns.erase(fd);
+        _connections--;
+    }
+
+    void Poll(Connection& conn)     //input until the peer's end, output while replies are waiting to go
+    {
+        uint32 events = (conn.bEnd ? 0u : uint32(EPOLLIN)) | ((conn.outPos < conn.out.size()) ? uint32(EPOLLOUT) : 0u);
+        if(events != conn.events)
+            Watch(conn.fd, events, !conn.events ? EPOLL_CTL_ADD : events ? EPOLL_CTL_MOD : EPOLL_CTL_DEL);
+        conn.events = events;
+    }
+    void Watch(int fd, uint32 events, int op)
+    {
+        epoll_event event = {};
+        event.events  = events;
+        event.data.fd = fd;
+        ::epoll_ctl(_epoll, op, fd, &event);
+    }
+    void Wake()
+    {
+        uint64 one = 1;
+        (void)::write(_wake, &one, sizeof(one));
+    }
+    void Close()
+    {
+        for(int* pFd : { &_listen, &_epoll, &_wake })
+        {
+            if(*pFd >= 0)
+                ::close(*pFd);
+            *pFd = -1;
+        }
+    }
+};
+
+}//namespace Serialize
+
+#endif //__linux__
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+#include <cstdint>
+
+#include "types.h"
+
+namespace Serialize {
+
+//Monotonic arena: allocations are bumped out of large blocks and only released when the arena is destroyed.
+//Not thread-safe: one arena per loading thread.  Archives loading on a pool (ShardedArchive shards, Global loads sharing
+//an IdentityRegistry) must not share one.
+class Arena
+{
+public:
+    enum { BLOCK_SIZE = 1 << 20, };
+
+    explicit Arena(size_t blockSize = BLOCK_SIZE) : _blockSize(blockSize) {}
+    Arena(const Arena&) = delete;
+    Arena& operator=(const Arena&) = delete;
+
+    void* Allocate(size_t size, size_t align)
+    {
+        uintptr_t pos = (_pos + (align - 1)) & ~uintptr_t(align - 1);
+        if(!_pos || (pos + size > _end))
+        {
+            size_t blockSize = (size + align > _blockSize) ? (size + align) : _blockSize;
+            _blocks.emplace_back(new BYTE[blockSize]);
+            _pos = uintptr_t(_blocks.back().get());
+            _end = _pos + blockSize;
+            pos  = (_pos + (align - 1)) & ~uintptr_t(align - 1);
+        }
+        _pos   = pos + size;
+        _used += size;
+        return (void*)pos;
+    }
+    size_t Used() const { return _used; }
+
+private:
+    std::vector<std::unique_ptr<BYTE[]>>    _blocks;
+    size_t                                  _blockSize;
+    uintptr_t                               _pos  = 0;
+    uintptr_t                               _end  = 0;
+    size_t                                  _used = 0;
+};
+
+//Allocator over a shared Arena.  Copies live in the shared_ptr control blocks made by std::allocate_shared, so the
+//arena stays alive until the last object allocated from it is released.
+template<typename Type>
+class ArenaAllocator
+{
+    template<typename Other> friend class ArenaAllocator;
+    std::shared_ptr<Arena> _pArena;
+
+public:
+    using value_type = Type;
+
+    ArenaAllocator(std::shared_ptr<Arena> pArena) : _pArena(std::move(pArena)) {}
+    template<typename Other> ArenaAllocator(const ArenaAllocator<Other>& other) : _pArena(other._pArena) {}
+
+    Type* allocate(size_t count)          { return (Type*)_pArena->Allocate(count * sizeof(Type), alignof(Type)); }
+    void  deallocate(Type*, size_t)       {}    //monotonic, released with the arena
+
+    template<typename Other> bool operator==(const ArenaAllocator<Other>& other) const { return _pArena == other._pArena; }
+    template<typename Other> bool operator!=(const ArenaAllocator<Other>& other) const { return _pArena != other._pArena; }
+};
+
+}//namespace Serialize
@@ -0,0 +1,95 @@
+#pragma once
+
+#include <cstddef>
+#include <cstring>
+
+#include "types.h"
+
+#if defined(__SSE4_2__) || defined(__AVX__)
+#include <nmmintrin.h>
+#endif
+
+namespace Serialize {
+
+//CRC-32C (Castagnoli).  Uses the SSE4.2 crc32 instruction when the build targets it, slicing-by-8 tables otherwise.
+//crc is the running state (start with ~0), no final xor is applied so the state carries across calls.
+class Crc32c
+{
+    enum : uint32 { POLY = 0x82F63B78, };   //reflected Castagnoli polynomial
+
+    struct Table
+    {
+        uint32 t[8][256];
+        Table()
+        {
+            for(uint32 i = 0; i < 256; i++)
+            {
+                uint32 crc = i;
+                for(int bit = 0; bit < 8; bit++)
+                    crc = (crc >> 1) ^ ((crc & 1) ? uint32(POLY) : 0);
+                t[0][i] = crc;
+            }
+            for(uint32 i = 0; i < 256; i++)
+                for(int k = 1; k < 8; k++)
+                    t[k][i] = (t[k - 1][i] >> 8) ^ t[0][t[k - 1][i] & 0xff];
+        }
+    };
+    static const Table& Tables() { static const Table table; return table; }
+
+public:
+    static uint32 Update(uint32 crc, const BYTE* pData, size_t size)
+    {
+#if (defined(__SSE4_2__) || defined(__AVX__)) && (defined(__x86_64__) || defined(_M_X64))
+        for(; size >= sizeof(uint64); size -= sizeof(uint64), pData += sizeof(uint64))
+        {
+            uint64 data;
+            std::memcpy(&data, pData, sizeof(data));
+            crc = uint32(_mm_crc32_u64(crc, data));
+        }
+        for(; size; size--)
+            crc = _mm_crc32_u8(crc, *pData++);
+#else
+        const Table& table = Tables();
+        for(; size >= 8; size -= 8, pData += 8)
+        {
+            uint32 lo = crc ^ (uint32(pData[0]) | (uint32(pData[1]) << 8) | (uint32(pData[2]) << 16) | (uint32(pData[3]) << 24));
+            uint32 hi =        uint32(pData[4]) | (uint32(pData[5]) << 8) | (uint32(pData[6]) << 16) | (uint32(pData[7]) << 24);
+            crc = table.t[7][lo & 0xff] ^ table.t[6][(lo >> 8) & 0xff] ^ table.t[5][(lo >> 16) & 0xff] ^ table.t[4][lo >> 24] ^
+                  table.t[3][hi & 0xff] ^ table.t[2][(hi >> 8) & 0xff] ^ table.t[1][(hi >> 16) & 0xff] ^ table.t[0][hi >> 24];
+        }
+        for(; size; size--)
+            crc = (crc >> 8) ^ table.t[0][(crc ^ *pData++) & 0xff];
+#endif
+        return crc;
+    }
+};
+
+//64 bit content hash, a word at a time (murmur3 finalizer), for telling changed bytes apart.  Not an integrity check.
+class Hash64
+{
+    static uint64 Mix(uint64 bits)
+    {
+        bits ^= bits >> 33;
+        bits *= 0xFF51AFD7ED558CCDULL;
+        bits ^= bits >> 33;
+        bits *= 0xC4CEB9FE1A85EC53ULL;
+        return bits ^ (bits >> 33);
+    }
+
+public:
+    static uint64 Of(const BYTE* pData, size_t size)
+    {
+        uint64 hash = 0x9E3779B97F4A7C15ULL ^ size;
+        for(; size >= sizeof(uint64); size -= sizeof(uint64), pData += sizeof(uint64))
+        {
+            uint64 data;
+            std::memcpy(&data, pData, sizeof(data));
+            hash = Mix(hash ^ data);
+        }
+        uint64 tail = 0;
+        std::memcpy(&tail, pData, size);
+        return Mix(hash ^ tail);
+    }
+};
+
+}//namespace Serialize
@@ -0,0 +1,222 @@
+#pragma once
+
+#include <vector>
+#include <cstring>
+#include <algorithm>
+
+#include "types.h"
+
+namespace Serialize {
+
+//LZ77 block codec in the LZ4 block layout: sequences of [token][literal length+][literals][offset16][match length+],
+//the token holds 4 bits of each length, 15 means more length bytes follow (each 255 means another one).
+//Blocks are independent.  Decompress() bounds checks everything, the input is untrusted.
+class Lz
+{
+public:
+    enum Level
+    {
+        Store   = 0,        //no compression
+        Fast    = 1,        //one probe per position, skips ahead faster through incompressible data
+        Default = 4,        //hash chains, 8 probes
+        Best    = 9,        //hash chains, 256 probes
+    };
+    enum { MIN_MATCH = 4, MAX_OFFSET = 0xFFFF, };
+
+    static uint32 Bound(uint32 size) { return size + size / 255 + 16; }     //largest output for size bytes
+
+    //compress size bytes into pDest, returns the compressed size or 0 when it does not fit in capacity
+    uint32 Compress(const BYTE* pSrc, uint32 size, BYTE* pDest, uint32 capacity, int level = Default)
+    {
+        if(level <= Store)
+            return 0;
+        if(_head.empty())
+        {
+            _head.resize(HASH_SIZE);
+            _chain.resize(WINDOW_SIZE);
+        }
+        std::fill(_head.begin(), _head.end(), 0);
+        uint32 probes = (level <= Fast) ? 1 : (1u << ((level < Best ? level : Best) - 1));
+
+        Writer out = { pDest, pDest + capacity };
+        uint32 anchor = 0;
+        uint32 pos    = 0;
+        uint32 limit  = (size > uint32(LAST_LITERALS) + MIN_MATCH) ? size - LAST_LITERALS : 0;    //last match starts before
+        while(pos < limit)
+        {
+            uint32 matchPos = 0;
+            uint32 matchLen = Find(pSrc, pos, size, probes, matchPos);
+            if(matchLen < MIN_MATCH)
+            {
+                pos += (level <= Fast) ? (1 + ((pos - anchor) >> SKIP_SHIFT)) : 1;
+                continue;
+            }
+            if(!out.Sequence(pSrc + anchor, pos - anchor, pos - matchPos, matchLen))
+                return 0;
+            uint32 end = pos + matchLen;
+            if(level > Fast)
+                for(pos++; (pos < end) && (pos < limit); pos++)
+                    Insert(pSrc, pos);
+            pos = anchor = end;
+        }
+        if(!out.Literals(pSrc + anchor, size - anchor))
+            return 0;
+        return uint32(out.p - pDest);
+    }
+
+    //decompress srcSize bytes into pDest, returns the decompressed size or -1 when the input is malformed
+    static int32 Decompress(const BYTE* pSrc, uint32 srcSize, BYTE* pDest, uint32 destSize)
+    {
+        const BYTE* ip    = pSrc;
+        const BYTE* ipEnd = pSrc + srcSize;
+        BYTE*       op    = pDest;
+        BYTE*       opEnd = pDest + destSize;
+        while(ip < ipEnd)
+        {
+            uint32 token = *ip++;
+            size_t lit = token >> 4;
+            if((lit == 15) && !Length(ip, ipEnd, lit))
+                return -1;
+            if((lit > size_t(ipEnd - ip)) || (lit > size_t(opEnd - op)))
+                return -1;
+            std::memcpy(op, ip, lit);
+            op += lit;
+            ip += lit;
+            if(ip == ipEnd)         //the last sequence is literals only
+                break;
+            if(ipEnd - ip < 2)
+                return -1;
+            size_t offset = size_t(ip[0]) | (size_t(ip[1]) << 8);
+            ip += 2;
+            size_t len = token & 15;
+            if((len == 15) && !Length(ip, ipEnd, len))
+                return -1;
+            len += MIN_MATCH;
+            if(!offset || (offset > size_t(op - pDest)) || (len > size_t(opEnd - op)))
+                return -1;
+            const BYTE* pMatch = op - offset;
+            if(offset >= len)
+                std::memcpy(op, pMatch, len);
+            else
+                for(size_t i = 0; i < len; i++)     //overlapping, repeats the last offset bytes
+                    op[i] = pMatch[i];
+            op += len;
+        }
+        return int32(op - pDest);
+    }
+
+private:
+    enum
+    {
+        HASH_BITS     = 16,
+        HASH_SIZE     = 1 << HASH_BITS,
+        WINDOW_SIZE   = MAX_OFFSET + 1,
+        LAST_LITERALS = 5,
+        SKIP_SHIFT    = 6,          //Fast: step grows by 1 every 64 bytes without a match
+    };
+
+    std::vector<uint32> _head;      //position + 1 of the latest 4 bytes with each hash, 0 == none
+    std::vector<uint32> _chain;     //position + 1 of the previous one, by position within the window
+
+    static uint32 Read32(const BYTE* p) { uint32 u; std::memcpy(&u, p, sizeof(u)); return u; }
+    static uint32 Hash(const BYTE* p)   { return (Read32(p) * 2654435761U) >> (32 - HASH_BITS); }
+
+    void Insert(const BYTE* pSrc, uint32 pos)
+    {
+        uint32& head = _head[Hash(pSrc + pos)];
+        _chain[pos & MAX_OFFSET] = head;
+        head = pos + 1;
+    }
+    uint32 Find(const BYTE* pSrc, uint32 pos, uint32 size, uint32 probes, uint32& matchPos)     //longest match, inserts pos
+    {
+        uint32 candidate = _head[Hash(pSrc + pos)];
+        Insert(pSrc, pos);
+        uint32 best = 0;
+        uint32 maxLen = size - LAST_LITERALS - pos;
+        while(candidate && probes--)
+        {
+            uint32 at = candidate - 1;
+            if(pos - at > MAX_OFFSET)
+                break;
+            if(Read32(pSrc + at) == Read32(pSrc + pos))
+            {
+                uint32 len = MIN_MATCH;
+                while((len < maxLen) && (pSrc[at + len] == pSrc[pos + len]))
+                    len++;
+                if(len > best)
+                {
+                    best = len;
+                    matchPos = at;
+                    if(len == maxLen)
+                        break;
+                }
+            }
+            uint32 next = _chain[at & MAX_OFFSET];
+            if(next >= candidate)       //slot reused by a newer position, the chain ends here
+                break;
+            candidate = next;
+        }
+        return best;
+    }
+
+    static bool Length(const BYTE*& ip, const BYTE* ipEnd, size_t& len)
+    {
+        BYTE b;
+        do
+        {
+            if(ip >= ipEnd)
+                return false;
+            b = *ip++;
+            len += b;
+        } while(b == 255);
+        return true;
+    }
+
+    struct Writer
+    {
+        BYTE* p;
+        BYTE* pEnd;
+
+        bool Length(size_t len)
+        {
+            for(; len >= 255; len -= 255)
+                if(!Byte(255)) return false;
+            return Byte(BYTE(len));
+        }
+        bool Byte(BYTE b)
+        {
+            if(p >= pEnd) return false;
+            *p++ = b;
+            return true;
+        }
+        bool Sequence(const BYTE* pLit, uint32 lit, uint32 offset, uint32 len)
+        {
+            len -= MIN_MATCH;
+            if(!Byte(BYTE(((lit < 15 ? lit : 15) << 4) | (len < 15 ? len : 15))))
+                return false;
+            if((lit >= 15) && !Length(lit - 15))
+                return false;
+            if(uint32(pEnd - p) < lit + 2)
+                return false;
+            std::memcpy(p, pLit, lit);
+            p += lit;
+            *p++ = BYTE(offset);
+            *p++ = BYTE(offset >> 8);
+            return (len < 15) || Length(len - 15);
+        }
+        bool Literals(const BYTE* pLit, uint32 lit)
+        {
+            if(!Byte(BYTE((lit < 15 ? lit : 15) << 4)))
+                return false;
+            if((lit >= 15) && !Length(lit - 15))
+                return false;
+            if(uint32(pEnd - p) < lit)
+                return false;
+            std::memcpy(p, pLit, lit);
+            p += lit;
+            return true;
+        }
+    };
+};
+
+}//namespace Serialize
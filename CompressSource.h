@@ -0,0 +1,382 @@
+#pragma once
+
+#include <deque>
+#include <memory>
+
+#include "DataSource.h"
+#include "Compress.h"
+#include "ThreadPool.h"
+
+namespace Serialize {
+
+//Framing shared by the compressing sources.  A block is [Dint rawSize][Dint compSize][compSize bytes], compSize 0 ==
+//stored raw.  rawSize 0 starts an index, [Dint 0][Dint count][count * (Dint rawSize, Dint compSize)], listing the
+//blocks since the previous index.
+class BlockSource : public IDataSource
+{
+public:
+    enum { BLOCK_SIZE = 256 * 1024, MAX_BLOCK = 16 * 1024 * 1024, MAX_DINT = 10, };
+
+    bool IsError() const     { return _bError; }
+    void SetLevel(int level) { _level = level; }
+
+protected:
+    struct Block
+    {
+        uint32              rawSize  = 0;
+        uint32              compSize = 0;
+        std::vector<BYTE>   data;       //save: header and payload, load: payload, then the raw bytes
+    };
+    enum Next { End, Data, Index, Bad, };
+
+    IDataSource&        _source;
+    int                 _level;
+    uint32              _blockSize;
+    std::vector<BYTE>   _out;           //save: pending bytes, not yet a block
+    std::vector<BYTE>   _in;            //load: the current block, [_inPos, _in.size()) not yet returned
+    uint32              _inPos  = 0;
+    bool                _bError = false;    //either direction, a two-way stream is out of step after one
+
+    BlockSource(IDataSource& source, int level, uint32 blockSize)
+        : _source(source), _level(level), _blockSize(std::max<uint32>(1, std::min<uint32>(blockSize, MAX_BLOCK))) {}
+
+    uint32 Append(const BYTE* pData, uint32 size)       //bytes taken into the pending block
+    {
+        uint32 count = std::min<uint32>(size, _blockSize - uint32(_out.size()));
+        _out.insert(_out.end(), pData, pData + count);
+        return count;
+    }
+    uint32 Take(void* pData, uint32 size)              //bytes handed out of the current block
+    {
+        size = std::min<uint32>(size, uint32(_in.size() - _inPos));
+        std::memcpy(pData, _in.data() + _inPos, size);
+        _inPos += size;
+        return size;
+    }
+
+    static void Encode(Lz& lz, int level, const BYTE* pRaw, uint32 rawSize, Block& block)
+    {
+        block.rawSize = rawSize;
+        block.data.resize(2 * MAX_DINT + Lz::Bound(rawSize));
+        BYTE* pPayload  = block.data.data() + 2 * MAX_DINT;
+        block.compSize  = lz.Compress(pRaw, rawSize, pPayload, rawSize - 1, level);     //must shrink, or it is stored
+        uint32 payload  = block.compSize ? block.compSize : rawSize;
+        if(!block.compSize)
+            std::memcpy(pPayload, pRaw, rawSize);
+        BYTE   header[2 * MAX_DINT];
+        uint32 headerSize = PutDint(header, rawSize);
+        headerSize += PutDint(header + headerSize, block.compSize);
+        std::memcpy(pPayload - headerSize, header, headerSize);
+        block.data.erase(block.data.begin(), block.data.begin() + (2 * MAX_DINT - headerSize));
+        block.data.resize(headerSize + payload);
+    }
+    static bool Decode(Block& block)            //payload to raw bytes in place
+    {
+        if(!block.compSize)
+            return true;
+        std::vector<BYTE> raw(block.rawSize);
+        if(Lz::Decompress(block.data.data(), block.compSize, raw.data(), block.rawSize) != int32(block.rawSize))
+            return false;
+        block.data.swap(raw);
+        return true;
+    }
+
+    Next ReadBlock(Block& block)                //next block or index header, a block's payload is read too
+    {
+        uint64 rawSize = 0;
+        uint64 compSize = 0;
+        if(!GetDint(rawSize, true))
+            return _bError ? Bad : End;
+        if(!GetDint(compSize))
+            return Bad;
+        if(!rawSize)
+        {
+            block.compSize = uint32(compSize);      //index: compSize is the entry count
+            return (compSize <= 0xFFFFFFFF) ? Index : Bad;
+        }
+        if((rawSize > MAX_BLOCK) || (compSize >= rawSize))
+            return Bad;
+        block.rawSize  = uint32(rawSize);
+        block.compSize = uint32(compSize);
+        block.data.resize(size_t(compSize ? compSize : rawSize));
+        return Receive(block.data.data(), uint32(block.data.size())) ? Data : Bad;
+    }
+    bool SkipIndex(uint32 count)                //the entries after an index header
+    {
+        uint64 size = 0;
+        for(; count; count--)
+            if(!GetDint(size) || !GetDint(size))
+                return false;
+        return true;
+    }
+    void WriteIndex(const std::vector<std::pair<uint32, uint32>>& entries)
+    {
+        std::vector<BYTE> index(2 * MAX_DINT * (entries.size() + 1));
+        uint32 size = PutDint(index.data(), 0);
+        size += PutDint(index.data() + size, entries.size());
+        for(auto& entry : entries)
+        {
+            size += PutDint(index.data() + size, entry.first);
+            size += PutDint(index.data() + size, entry.second);
+        }
+        Send(index.data(), size);
+    }
+
+    bool Send(const BYTE* pData, size_t size)
+    {
+        while(size && !_bError)
+        {
+            int32 ret = _source.save((void*)pData, uint32(std::min<size_t>(size, 0x40000000)));
+            if(ret <= 0)
+                _bError = true;
+            else
+            {
+                pData += ret;
+                size  -= uint32(ret);
+            }
+        }
+        return !_bError;
+    }
+    bool Receive(BYTE* pData, uint32 size)
+    {
+        while(size)
+        {
+            int32 ret = _source.load(pData, size);
+            if(ret <= 0)
+                return false;
+            pData += ret;
+            size  -= uint32(ret);
+        }
+        return true;
+    }
+
+    static uint32 PutDint(BYTE* pData, uint64 dint)     //same encoding as Archive::SaveDint
+    {
+        uint32 size = 0;
+        for(; dint >= 0x80; dint >>= 7)
+            pData[size++] = BYTE(dint & 0x7f);
+        pData[size++] = BYTE(dint | 0x80);
+        return size;
+    }
+    bool GetDint(uint64& dint, bool bFirst = false)     //bFirst: a clean end of stream is not an error
+    {
+        dint = 0;
+        BYTE u8 = 0;
+        for(uint32 shift = 0; !(u8 & 0x80); shift += 7)
+        {
+            if((shift > 63) || !Receive(&u8, sizeof(u8)))
+            {
+                _bError |= !(bFirst && !shift);
+                return false;
+            }
+            dint |= uint64(u8 & 0x7f) << shift;
+        }
+        return true;
+    }
+};
+
+//Compresses saves in framed blocks on the caller's thread.
+//A block is cut when BlockSize bytes are pending or on flush(), so Archive checkpoints end on a block boundary.
+class CompressSource : public BlockSource
+{
+    Lz      _lz;
+    Block   _block;
+
+    virtual int32 save(void* pData, uint32 size)
+    {
+        const BYTE* pBytes = (const BYTE*)pData;
+        for(uint32 left = size; left; )
+        {
+            uint32 count = Append(pBytes, left);
+            pBytes += count;
+            left   -= count;
+            if((_out.size() >= _blockSize) && !Pack())
+                return -1;
+        }
+        return int32(size);
+    }
+    virtual int32 load(void* pData, uint32 size)
+    {
+        if((_inPos >= _in.size()) && !Unpack())
+            return -1;
+        return int32(Take(pData, size));
+    }
+    virtual void flush()        //pending saves go out as a block whatever was loaded in between
+    {
+        if(!_out.empty())
+            Pack();
+        _source.flush();
+    }
+
+    bool Pack()
+    {
+        Encode(_lz, _level, _out.data(), uint32(_out.size()), _block);
+        _out.clear();
+        return Send(_block.data.data(), _block.data.size());
+    }
+    bool Unpack()       //next block, false at the end of the stream or on a bad block
+    {
+        _in.clear();
+        _inPos = 0;
+        for(;;)
+        {
+            switch(_bError ? Bad : ReadBlock(_block))
+            {
+            case Data:
+                if(!Decode(_block))
+                    break;
+                _in.swap(_block.data);
+                return true;
+            case Index:         //written by ParallelCompressSource, nothing to check here
+                if(!SkipIndex(_block.compSize))
+                    break;
+                continue;
+            case End:
+                return false;
+            default:
+                break;
+            }
+            _bError = true;
+            return false;
+        }
+    }
+
+public:
+    CompressSource(IDataSource& source, int level = Lz::Default, uint32 blockSize = BLOCK_SIZE)
+        : BlockSource(source, level, blockSize) {}
+    ~CompressSource() { if(!_out.empty()) Pack(); }
+};
+
+//Compresses blocks on a thread pool and writes them in order, with an index of the blocks at every flush().
+//Loads read blocks ahead and decompress them on the pool, reading ahead stops at an index so a two-way stream
+//never waits on bytes the other side has not sent yet.  Reads CompressSource streams too (ahead without stopping).
+class ParallelCompressSource : public BlockSource
+{
+    std::unique_ptr<ThreadPool>             _pOwnPool;
+    ThreadPool&                             _pool;
+    std::deque<std::future<Block>>          _saving;        //save: blocks being compressed, in stream order
+    std::deque<std::future<Block>>          _loading;       //load: blocks being decompressed, in stream order
+    std::vector<std::pair<uint32, uint32>>  _index;         //save: blocks since the last index
+    uint64                                  _blocks = 0;    //load: blocks since the last index
+    bool                                    _bSync  = false;//load: at an index, wait for the caller to drain
+
+    virtual int32 save(void* pData, uint32 size)
+    {
+        const BYTE* pBytes = (const BYTE*)pData;
+        for(uint32 left = size; left; )
+        {
+            uint32 count = Append(pBytes, left);
+            pBytes += count;
+            left   -= count;
+            if(_out.size() >= _blockSize)
+                Submit();
+        }
+        return _bError ? -1 : int32(size);
+    }
+    virtual int32 load(void* pData, uint32 size)
+    {
+        if((_inPos >= _in.size()) && !Unpack())
+            return -1;
+        return int32(Take(pData, size));
+    }
+    virtual void flush()        //pending saves go out with their index whatever was loaded in between
+    {
+        if(!_out.empty())
+            Submit();
+        Drain(0);
+        if(!_index.empty())
+            WriteIndex(_index);
+        _index.clear();
+        _source.flush();
+    }
+
+    uint32 Ahead() const { return 2 * _pool.Size(); }      //blocks in flight
+    void Submit()
+    {
+        std::shared_ptr<std::vector<BYTE>> pRaw = std::make_shared<std::vector<BYTE>>();
+        pRaw->swap(_out);
+        int level = _level;
+        _saving.push_back(_pool.Submit([pRaw, level]
+        {
+            thread_local Lz lz;
+            Block block;
+            Encode(lz, level, pRaw->data(), uint32(pRaw->size()), block);
+            return block;
+        }));
+        _out.reserve(_blockSize);
+        Drain(Ahead());
+    }
+    void Drain(size_t keep)     //write finished blocks in order until at most keep are in flight
+    {
+        while(_saving.size() > keep)
+        {
+            Block block = _saving.front().get();
+            _saving.pop_front();
+            _index.emplace_back(block.rawSize, block.compSize);
+            Send(block.data.data(), block.data.size());
+        }
+    }
+
+    bool Unpack()
+    {
+        _in.clear();
+        _inPos = 0;
+        while(!_bSync && !_bError && (_loading.size() < Ahead()))
+        {
+            Block block;
+            Next next = ReadBlock(block);
+            if(next == Data)
+            {
+                _blocks++;
+                _loading.push_back(_pool.Submit([block = std::move(block)]() mutable
+                {
+                    if(!Decode(block))
+                        block.data.clear();     //never empty otherwise
+                    return std::move(block);
+                }));
+            }
+            else if(next == Index)
+            {
+                if((block.compSize != _blocks) || !SkipIndex(block.compSize))
+                    _bError = true;
+                _blocks = 0;
+                _bSync  = true;
+            }
+            else
+            {
+                _bError |= (next == Bad);
+                break;
+            }
+        }
+        if(_loading.empty())
+        {
+            bool bMore = _bSync && !_bError;
+            _bSync = false;
+            return bMore && Unpack();   //past the index, the caller wants more
+        }
+        Block block = _loading.front().get();
+        _loading.pop_front();
+        if(block.data.empty())
+        {
+            _bError = true;
+            return false;
+        }
+        _in.swap(block.data);
+        return true;
+    }
+
+public:
+    ParallelCompressSource(IDataSource& source, int level = Lz::Default, uint32 threads = 0, uint32 blockSize = BLOCK_SIZE)
+        : BlockSource(source, level, blockSize), _pOwnPool(new ThreadPool(threads)), _pool(*_pOwnPool) {}
+    ParallelCompressSource(IDataSource& source, ThreadPool& pool, int level = Lz::Default, uint32 blockSize = BLOCK_SIZE)
+        : BlockSource(source, level, blockSize), _pool(pool) {}
+    ~ParallelCompressSource()
+    {
+        if(!_out.empty() || !_saving.empty())
+            flush();
+        for(auto& loading : _loading)   //jobs still running hold nothing of ours, but wait for them
+            loading.wait();
+    }
+};
+
+}//namespace Serialize
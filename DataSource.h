@@ -1,8 +1,11 @@
 #pragma once
 
 #include "types.h"
+#include "Transform.h"
 #include <vector>
 #include <string>
+#include <cstring>
+#include <algorithm>
 
 #include <fstream>
 #ifdef _MSC_VER
@@ -12,15 +15,20 @@
 #else
 #include <netdb.h>
 #include <sys/socket.h>
+#include <sys/uio.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
 #include <stdlib.h>
 #include <unistd.h>
+#include <cerrno>
 
 using SOCKET        = int;
 using ADDRINFO      = addrinfo;
 using SOCKADDR      = sockaddr;
 using SOCKADDR_IN   = sockaddr_in;
 
-constexpr auto SOCKET_ERROR = -1;
+constexpr auto SOCKET_ERROR   = -1;
+constexpr auto INVALID_SOCKET = -1;
 #define closesocket(x) close(x)
 #endif
 
@@ -30,141 +38,381 @@ class IDataSource
 {
 public:
     virtual ~IDataSource() = default;
-    virtual int32 save(void* pData, uint32 size) = 0;
-    virtual int32 load(void* pData, uint32 size) = 0;
+    virtual int32 save(void* pData, uint32 size) = 0;   //bytes written, may be short
+    virtual int32 load(void* pData, uint32 size) = 0;   //bytes read, may be short (like recv), <= 0 at the end
+    virtual void  flush() {}                            //end of a batch of saves
+
+    //memory backed sources can lend up to size bytes of their input instead of copying them (size is updated),
+    //the bytes are consumed and stay valid for the lifetime of the source
+    virtual const BYTE* view(uint32& /*size*/) { return nullptr; }
+    virtual bool        unload(uint32 /*size*/) { return false; }  //give back the last size bytes loaded or viewed, unread
+    virtual int64       remaining()        { return -1; }       //bytes left to load, -1 when unknown (streams)
+    virtual bool        seek(uint64 /*offset*/) { return false; }   //random access sources move the load position
 };
 
 class FileSource : public IDataSource
 {
     using Mode = std::ios_base::openmode;
     std::fstream _file;
+    int64        _size = -1;
 
-    virtual int32 save(void* pData, uint32 size)  { _file.write((char*)pData, size); return size; };
-    virtual int32 load(void* pData, uint32 size)  { _file.read( (char*)pData, size); return size; };
+    virtual int32 save(void* pData, uint32 size)  { _file.write((char*)pData, size); return _file ? size : -1; };
+    virtual int32 load(void* pData, uint32 size)  { _file.read( (char*)pData, size); return (int32)_file.gcount(); };
+    virtual void  flush()                         { _file.flush(); }
+    virtual int64 remaining()                     { return (_size < 0 || !_file) ? -1 : _size - int64(_file.tellg()); }
+    virtual bool  seek(uint64 offset)             { _file.clear(); return (_size >= 0) && (offset <= uint64(_size)) && _file.seekg(std::streamoff(offset)); }
 
 public:
     static const Mode Load = std::ios_base::binary | std::ios_base::in;
     static const Mode Save = std::ios_base::binary | std::ios_base::out | std::ios_base::trunc;
 
-    FileSource(const char* pFilename, const Mode mode = Save) : _file(pFilename, mode) {}
+    FileSource(const char* pFilename, const Mode mode = Save) : _file(pFilename, mode)
+    {
+        if((mode & std::ios_base::in) && _file.seekg(0, std::ios_base::end))
+        {
+            _size = int64(_file.tellg());
+            _file.seekg(0, std::ios_base::beg);
+        }
+    }
 };
 
 class SocketSource : public IDataSource
 {
-    SOCKET _sock;
+    enum
+    {
+        SEND_BUFFER   = 64 * 1024,          //small saves are batched until a flush() or a large save
+        SOCKET_BUFFER = 4 * 1024 * 1024,    //SO_SNDBUF/SO_RCVBUF
+    };
+
+    SOCKET              _sock   = INVALID_SOCKET;
+    std::vector<BYTE>   _sendBuffer;
+    bool                _bError = false;
+
+    virtual int32 save(void* pData, uint32 size)
+    {
+        if(_bError) return -1;
+        if(size <= SEND_BUFFER - _sendBuffer.size())
+        {
+            _sendBuffer.insert(_sendBuffer.end(), (BYTE*)pData, (BYTE*)pData + size);
+            return size;
+        }
+        return Send((BYTE*)pData, size, true) ? int32(size) : -1;
+    };
+    virtual int32 load(void* pData, uint32 size)    //like recv, Archive loops until it has what it needs
+    {
+        for(;;)
+        {
+            int32 ret = (int32)::recv(_sock, (char*)pData, size, 0);
+            if((ret >= 0) || !Interrupted())
+                return ret;
+        }
+    };
+    virtual void flush()                            //end of a message, send what is batched now
+    {
+        if(!_sendBuffer.empty() && !_bError)
+            Send(nullptr, 0, false);
+    }
 
-    virtual int32 save(void* pData, uint32 size)  { return (int32)::send(_sock, (char*)pData, size, 0); };
-    virtual int32 load(void* pData, uint32 size)  { return (int32)::recv(_sock, (char*)pData, size, 0); };
+    bool Send(const BYTE* pData, uint32 size, bool bMore)     //the batched bytes then pData, in one gather write
+    {
+        const BYTE* pPart[2] = { _sendBuffer.data(), pData };
+        size_t      left[2]  = { _sendBuffer.size(), size };
+        for(int part = 0; (part < 2) && !_bError; )
+        {
+            if(!left[part])
+            {
+                part++;
+                continue;
+            }
+            int count = (part == 0 && left[1]) ? 2 : 1;
+#ifdef _MSC_VER
+            WSABUF buffers[2];
+            for(int i = 0; i < count; i++)
+            {
+                buffers[i].buf = (char*)pPart[part + i];
+                buffers[i].len = ULONG(left[part + i]);
+            }
+            DWORD sent = 0;
+            int64 ret = (::WSASend(_sock, buffers, DWORD(count), &sent, 0, nullptr, nullptr) == SOCKET_ERROR) ? -1 : int64(sent);
+#else
+            iovec buffers[2];
+            for(int i = 0; i < count; i++)
+            {
+                buffers[i].iov_base = (void*)pPart[part + i];
+                buffers[i].iov_len  = left[part + i];
+            }
+            msghdr msg = {};
+            msg.msg_iov    = buffers;
+            msg.msg_iovlen = count;
+            int flags = 0;
+#ifdef MSG_NOSIGNAL
+            flags |= MSG_NOSIGNAL;      //a closed peer is an error, not SIGPIPE
+#endif
+#ifdef MSG_MORE
+            if(bMore)
+                flags |= MSG_MORE;      //more of this message follows, let the kernel fill the segments
+#endif
+            int64 ret = int64(::sendmsg(_sock, &msg, flags));
+            if((ret < 0) && Interrupted())
+                continue;
+#endif
+            if(ret <= 0)
+            {
+                _bError = true;
+                break;
+            }
+            for(size_t sent = size_t(ret); sent; )
+            {
+                size_t n = std::min(sent, left[part]);
+                pPart[part] += n;
+                left[part]  -= n;
+                sent        -= n;
+                if(!left[part])
+                    part++;
+            }
+        }
+        _sendBuffer.clear();
+        return !_bError;
+    }
+
+    static bool Interrupted()
+    {
+#ifdef _MSC_VER
+        return false;
+#else
+        return errno == EINTR;
+#endif
+    }
+    static void SetOptions(SOCKET sock, bool bConnected)    //buffers before connect/listen, no Nagle delay once connected
+    {
+        int opt = SOCKET_BUFFER;
+        ::setsockopt(sock, SOL_SOCKET, SO_SNDBUF, (const char*)&opt, sizeof(opt));
+        ::setsockopt(sock, SOL_SOCKET, SO_RCVBUF, (const char*)&opt, sizeof(opt));
+        opt = 1;
+        if(bConnected)
+            ::setsockopt(sock, IPPROTO_TCP, TCP_NODELAY, (const char*)&opt, sizeof(opt));
+    }
 
     void Init()
     {
 #ifdef _MSC_VER
         static WSADATA _wsaData = { 0 };
-        static int wsa = WSAStartup(MAKEWORD(1, 0), &_wsaData);
+        static int wsa = WSAStartup(MAKEWORD(2, 2), &_wsaData);
 #endif
+        _sendBuffer.reserve(SEND_BUFFER);
     }
 
 public:
-    SocketSource(const char* pName, const short port = 27015) : _sock(0)        //client
+    SocketSource(const char* pName, const short port = 27015)        //client
     {
         Init();
+        ADDRINFO hints = {};
+        hints.ai_socktype = SOCK_STREAM;
+        hints.ai_protocol = IPPROTO_TCP;
         ADDRINFO* pAddr = nullptr;
-        ::getaddrinfo(pName, std::to_string(port).c_str(), nullptr, &pAddr);
+        ::getaddrinfo(pName, std::to_string(port).c_str(), &hints, &pAddr);
         for(ADDRINFO *ptr = pAddr; ptr; ptr = ptr->ai_next)
         {
             _sock = ::socket(ptr->ai_family, ptr->ai_socktype, ptr->ai_protocol);
+            if(_sock == INVALID_SOCKET)
+                continue;
+            SetOptions(_sock, false);
             if(::connect(_sock, ptr->ai_addr, (int)ptr->ai_addrlen) != SOCKET_ERROR)
+            {
+                SetOptions(_sock, true);
                 break;
-
+            }
             ::closesocket(_sock);
+            _sock = INVALID_SOCKET;
         }
-        ::freeaddrinfo(pAddr);
+        if(pAddr)
+            ::freeaddrinfo(pAddr);
     }
-    SocketSource(short port = 27015) : _sock(0)     //server
+    SocketSource(short port = 27015)        //server
     {
         Init();
         int opt = 1;
         SOCKADDR_IN sa = {AF_INET, htons(port), {INADDR_ANY},};
         SOCKET sock = ::socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
         ::setsockopt(sock, SOL_SOCKET, SO_REUSEADDR, (const char*)&opt, sizeof(opt));
+        SetOptions(sock, false);        //inherited by the accepted socket
         ::bind(sock, (SOCKADDR *)&sa, sizeof(sa));
         ::listen(sock, SOMAXCONN);
         _sock = ::accept(sock, nullptr, nullptr);
+        if(_sock != INVALID_SOCKET)
+            SetOptions(_sock, true);
         ::closesocket(sock);
     }
     ~SocketSource()
     {
-        if(_sock)
-            closesocket(_sock);
+        if(_sock == INVALID_SOCKET)
+            return;
+        flush();
+        closesocket(_sock);
     }
+
+    bool IsOpen() const  { return _sock != INVALID_SOCKET; }
+    bool IsError() const { return _bError; }
 };
 
-class FilterSource : public IDataSource
+class FilterSource : public IDataSource   //applies an ITransform (by default a single byte XOR mask) to the stream
 {
-    IDataSource& _source;
-    BYTE         _mask = 0;
+    enum { SCRATCH_SIZE = 64 * 1024, };
+
+    IDataSource&        _source;
+    XorTransform        _xor;
+    ITransform*         _pTransform = nullptr;     //nullptr == _xor
+    std::vector<BYTE>   _scratch;       //save: transformed bytes, reused and never larger than SCRATCH_SIZE
 
     virtual int32 save(void* pVoid, uint32 size)
     {
-        std::vector<BYTE> data(size);
-        Mask(data.data(), (BYTE*)pVoid, size);
-        return _source.save(data.data(), size);
+        if(!Transform().modifies())     //the caller's bytes go out as they are, never written to
+        {
+            Transform().observe((const BYTE*)pVoid, size);
+            return Send((const BYTE*)pVoid, size) ? int32(size) : -1;
+        }
+        if(_scratch.size() < std::min<uint32>(size, SCRATCH_SIZE))
+            _scratch.resize(std::min<uint32>(std::max<uint32>(size, 4096), SCRATCH_SIZE));
+        const BYTE* pSrc = (const BYTE*)pVoid;
+        for(uint32 left = size; left; )
+        {
+            uint32 count = std::min<uint32>(left, uint32(_scratch.size()));
+            Transform().encode(_scratch.data(), pSrc, count);
+            if(!Send(_scratch.data(), count))       //transformed bytes are committed, all or nothing
+                return -1;
+            pSrc += count;
+            left -= count;
+        }
+        return int32(size);
     }
     virtual int32 load(void* pData, uint32 size)
     {
         int32 ret = _source.load(pData, size);
-        Mask((BYTE*)pData, (BYTE*)pData, size);
+        if(ret > 0)
+            Transform().decode((BYTE*)pData, uint32(ret));
         return ret;
     }
+    virtual void  flush()     { _source.flush(); }
+    virtual int64 remaining() { return _source.remaining(); }
 
-    void Mask(BYTE* pDest, BYTE* pSrc, uint32 size)
+    ITransform& Transform() { return _pTransform ? *_pTransform : _xor; }
+    bool Send(const BYTE* pData, uint32 size)
     {
-        while(size--)
-            *pDest++ = *pSrc++ ^ _mask;
+        while(size)
+        {
+            int32 ret = _source.save((void*)pData, size);
+            if(ret <= 0)
+                return false;
+            pData += ret;
+            size  -= uint32(ret);
+        }
+        return true;
     }
 
 public:
-    FilterSource(IDataSource& source, BYTE mask = 0) : _source(source), _mask(mask) {}
-    void SetMask(BYTE mask) { _mask = mask; }
+    FilterSource(IDataSource& source, BYTE mask = 0) : _source(source), _xor(mask) {}
+    FilterSource(IDataSource& source, ITransform& transform) : _source(source), _pTransform(&transform) {}
+    void SetMask(BYTE mask) { _xor.SetMask(mask); }
 };
 
+//Growable buffer.  Saves copy into spare room, doubling the buffer when it fills up, so loads copy rather than lend
+//(a save can move the blob under a view), a SpanSource over Buffer() and Size() loads it in place.
+//TakeData() and the Data&& constructor/SetData move the blob out and in, for snapshots that are never copied.
 class MemorySource : public IDataSource
 {
     using Data = std::vector<BYTE>;
-    Data    _blob;
-    uint32  _offset = 0;
+    enum { MIN_SIZE = 4096, };
+
+    Data    _blob;              //[0, _size) saved, the rest is room to grow
+    size_t  _size   = 0;
+    size_t  _offset = 0;        //load position
 
     virtual int32 save(void* pData, uint32 size)
     {
-        _blob.insert(_blob.end(), ((BYTE*)pData), ((BYTE*)pData) + size);
-        _offset += size;
+        if(_blob.size() - _size < size)
+            _blob.resize(std::max({ _blob.size() * 2, _size + size, size_t(MIN_SIZE) }));
+        std::memcpy(_blob.data() + _size, pData, size);
+        _size += size;
         return size;
     };
     virtual int32 load(void* pData, uint32 size)
     {
-        if(_blob.size() < _offset + size) return -1;
+        if(_offset >= _size) return -1;
+        size = uint32(std::min<size_t>(size, _size - _offset));
         std::memcpy(pData, _blob.data() + _offset, size);
         _offset += size;
         return size;
     };
+    virtual bool  unload(uint32 size) { return (size <= _offset) ? (_offset -= size, true) : false; }
+    virtual int64 remaining() { return int64(_size - _offset); }
+    virtual bool  seek(uint64 offset) { return (offset <= _size) ? (_offset = size_t(offset), true) : false; }
 
 public:
     MemorySource(const size_t size=0) { if(size) _blob.reserve(size); }
     MemorySource(const Data& blob) { SetData(blob); }
+    MemorySource(Data&& blob)      { SetData(std::move(blob)); }
 
-    void Reset() { _blob.clear(); _offset = 0; }
+    void Reset() { _size = _offset = 0; }       //keeps the buffer for the next snapshot
 
-    Data GetData() const
+    Data GetData() const { return Data(_blob.begin(), _blob.begin() + _size); }
+    Data TakeData()                             //the saved bytes, without a copy, leaving the source empty
     {
+        _blob.resize(_size);
         Data blob;
-        blob.assign(_blob.begin(), _blob.end());
+        blob.swap(_blob);
+        Reset();
         return blob;
     }
     void SetData(const Data& blob)
     {
         _blob.assign(blob.begin(), blob.end());
+        _size = _blob.size();
         _offset = 0;
     }
+    void SetData(Data&& blob)
+    {
+        _blob = std::move(blob);
+        _size = _blob.size();
+        _offset = 0;
+    }
+
+    const BYTE* Buffer() const { return _blob.data(); }
+    size_t      Size() const   { return _size; }
+};
+
+//Loads from borrowed memory (a received packet, a MemorySource's Buffer(), a string) without copying it first.
+//The caller keeps the bytes alive and unchanged while the source, and anything viewed from it, is in use.
+class SpanSource : public IDataSource
+{
+    const BYTE* _pData;
+    size_t      _size;
+    size_t      _offset = 0;
+
+    virtual int32 save(void* /*pData*/, uint32 /*size*/) { return -1; }
+    virtual int32 load(void* pData, uint32 size)
+    {
+        const BYTE* pView = view(size);
+        if(!pView) return -1;
+        std::memcpy(pData, pView, size);
+        return size;
+    };
+    virtual const BYTE* view(uint32& size)
+    {
+        if(_offset >= _size) return nullptr;
+        size = uint32(std::min<size_t>(size, _size - _offset));
+        const BYTE* pView = _pData + _offset;
+        _offset += size;
+        return pView;
+    }
+    virtual bool  unload(uint32 size) { return (size <= _offset) ? (_offset -= size, true) : false; }
+    virtual int64 remaining() { return int64(_size - _offset); }
+    virtual bool  seek(uint64 offset) { return (offset <= _size) ? (_offset = size_t(offset), true) : false; }
+
+public:
+    SpanSource(const void* pData, size_t size) : _pData((const BYTE*)pData), _size(size) {}
+    SpanSource(const std::vector<BYTE>& blob) : SpanSource(blob.data(), blob.size()) {}
+
+    void Reset() { _offset = 0; }
 };
 
 }//namespace Serialize
@@ -0,0 +1,160 @@
+#pragma once
+
+#include "DataSource.h"
+
+namespace Serialize {
+
+//Length prefixed messages over a stream: [uint32 size, network order][size bytes].  Everything saved up to a flush()
+//(Archive::Flush, CheckPoint, a switch from << to >>) is one message, sent with one save on the source.  Loads read
+//ahead as much as the source has in one call and never hand out bytes past the end of the current message.
+//ReadMessage/WriteMessage/SkipMessage move whole messages without an Archive, to forward or drop them undecoded.
+class FrameSource : public IDataSource
+{
+public:
+    enum { HEADER_SIZE = 4, READ_SIZE = 64 * 1024, MAX_MESSAGE = 0x40000000, };
+
+private:
+    IDataSource&        _source;
+    std::vector<BYTE>   _out;               //[header][payload being saved]
+    std::vector<BYTE>   _in;                //read ahead, [_inPos, _inEnd) not consumed yet
+    uint32              _inPos  = 0;
+    uint32              _inEnd  = 0;
+    uint32              _left   = 0;        //payload bytes of the current message not loaded yet
+    bool                _bError = false;
+
+    virtual int32 save(void* pData, uint32 size)
+    {
+        if(_bError || (size > MAX_MESSAGE - (_out.size() - HEADER_SIZE)))
+            return -1;
+        _out.insert(_out.end(), (BYTE*)pData, (BYTE*)pData + size);
+        return int32(size);
+    }
+    virtual int32 load(void* pData, uint32 size)
+    {
+        if(!_left && !Next())
+            return -1;
+        size = std::min(size, _left);
+        if((_inPos == _inEnd) && (size >= READ_SIZE))    //large, straight from the source
+        {
+            int32 ret = _source.load(pData, size);
+            if(ret > 0)
+                _left -= uint32(ret);
+            return ret;
+        }
+        if((_inPos == _inEnd) && !Fill())
+            return -1;
+        size = std::min(size, _inEnd - _inPos);
+        std::memcpy(pData, _in.data() + _inPos, size);
+        _inPos += size;
+        _left  -= size;
+        return int32(size);
+    }
+    virtual void flush()
+    {
+        if(_out.size() > HEADER_SIZE)
+        {
+            PutSize(_out.data(), uint32(_out.size() - HEADER_SIZE));
+            Send(_out.data(), uint32(_out.size()));
+            _out.resize(HEADER_SIZE);
+        }
+        _source.flush();
+    }
+
+    bool Fill()         //read what the source has, at least one byte
+    {
+        if(_inPos == _inEnd)
+            _inPos = _inEnd = 0;
+        if(_in.size() - _inEnd < READ_SIZE / 2)     //keep a useful amount of room, moving the unread bytes down
+        {
+            std::memmove(_in.data(), _in.data() + _inPos, _inEnd - _inPos);
+            _inEnd -= _inPos;
+            _inPos  = 0;
+        }
+        int32 ret = _source.load(_in.data() + _inEnd, uint32(_in.size() - _inEnd));
+        if(ret <= 0)
+            return false;
+        _inEnd += uint32(ret);
+        return true;
+    }
+    bool Next()         //header of the next non empty message
+    {
+        while(!_left && !_bError)
+        {
+            while(_inEnd - _inPos < HEADER_SIZE)
+                if(!Fill())
+                    return false;   //end of the stream (or cut inside a header)
+            _left = GetSize(_in.data() + _inPos);
+            _inPos += HEADER_SIZE;
+            _bError = (_left > MAX_MESSAGE);
+        }
+        return !_bError;
+    }
+    bool Consume(BYTE* pDest, uint32 size)      //size bytes of the current message, to pDest or dropped
+    {
+        while(size)
+        {
+            if((_inPos == _inEnd) && !Fill())
+                return false;
+            uint32 count = std::min(size, _inEnd - _inPos);
+            if(pDest)
+            {
+                std::memcpy(pDest, _in.data() + _inPos, count);
+                pDest += count;
+            }
+            _inPos += count;
+            _left  -= count;
+            size   -= count;
+        }
+        return true;
+    }
+    bool Send(const BYTE* pData, uint32 size)
+    {
+        while(size && !_bError)
+        {
+            int32 ret = _source.save((void*)pData, size);
+            if(ret <= 0)
+                _bError = true;
+            else
+            {
+                pData += ret;
+                size  -= uint32(ret);
+            }
+        }
+        return !_bError;
+    }
+
+public:
+    static void   PutSize(BYTE* pData, uint32 size) { for(int i = HEADER_SIZE - 1; i >= 0; i--, size >>= 8) pData[i] = BYTE(size); }
+    static uint32 GetSize(const BYTE* pData)        { uint32 size = 0; for(int i = 0; i < HEADER_SIZE; i++) size = (size << 8) | pData[i]; return size; }
+
+    FrameSource(IDataSource& source) : _source(source), _out(HEADER_SIZE), _in(READ_SIZE) {}
+    ~FrameSource() { if(_out.size() > HEADER_SIZE) flush(); }
+
+    bool ReadMessage(std::vector<BYTE>& message)        //the rest of the current message, or the next one
+    {
+        if(!_left && !Next())
+            return false;
+        message.resize(_left);
+        return Consume(message.data(), _left);
+    }
+    bool SkipMessage()
+    {
+        return (_left || Next()) && Consume(nullptr, _left);
+    }
+    bool WriteMessage(const void* pData, uint32 size)   //a whole message, after ending the one being saved
+    {
+        if(size > MAX_MESSAGE)
+            return false;
+        flush();
+        BYTE header[HEADER_SIZE];
+        PutSize(header, size);
+        bool bOk = Send(header, HEADER_SIZE) && Send((const BYTE*)pData, size);
+        _source.flush();
+        return bOk;
+    }
+
+    uint32 Pending() const { return _left; }            //bytes of the current message not loaded yet
+    bool   IsError() const { return _bError; }
+};
+
+}//namespace Serialize
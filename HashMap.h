@@ -0,0 +1,82 @@
+#pragma once
+
+#include <vector>
+#include <cstring>
+#include <utility>
+
+#include "types.h"
+
+namespace Serialize {
+
+//Open addressing (linear probing) hash map for pointer or integer keys, a drop-in for the std::map lookups in Archive.
+//Key() marks an empty slot, so the zero/nullptr key is kept out of line.  Capacity is a power of 2, at most half full.
+template<typename Key, typename Value>
+class HashMap
+{
+    using Slot = std::pair<Key, Value>;
+    enum { MIN_CAPACITY = 16, };
+
+public:
+    Value& operator[](const Key key)
+    {
+        if(key == Key())
+        {
+            _bZero = true;
+            return _zero;
+        }
+        if((_count + 1) * 2 > _slots.size())
+            Grow();
+        Slot& slot = _slots[Probe(key)];
+        if(slot.first == Key())
+        {
+            slot.first = key;
+            _count++;
+        }
+        return slot.second;
+    }
+    Value* find(const Key key)
+    {
+        if(key == Key())
+            return _bZero ? &_zero : nullptr;
+        if(!_count)
+            return nullptr;
+        Slot& slot = _slots[Probe(key)];
+        return (slot.first == Key()) ? nullptr : &slot.second;
+    }
+
+    size_t size() const { return _count + (_bZero ? 1 : 0); }
+    void   clear()
+    {
+        std::vector<Slot>().swap(_slots);
+        _count = 0;
+        _zero  = Value();
+        _bZero = false;
+    }
+
+private:
+    size_t Probe(const Key key) const       //slot holding key, or the empty slot where it belongs
+    {
+        uint64 bits = 0;
+        std::memcpy(&bits, &key, sizeof(key));
+        size_t mask = _slots.size() - 1;
+        size_t i = size_t((bits * 0x9E3779B97F4A7C15ULL) >> 32) & mask;
+        while((_slots[i].first != key) && (_slots[i].first != Key()))
+            i = (i + 1) & mask;
+        return i;
+    }
+    void Grow()
+    {
+        std::vector<Slot> old(_slots.empty() ? size_t(MIN_CAPACITY) : _slots.size() * 2);
+        old.swap(_slots);
+        for(Slot& slot : old)
+            if(slot.first != Key())
+                _slots[Probe(slot.first)] = std::move(slot);
+    }
+
+    std::vector<Slot>   _slots;
+    size_t              _count = 0;
+    Value               _zero  = {};
+    bool                _bZero = false;
+};
+
+}//namespace Serialize
@@ -0,0 +1,141 @@
+#pragma once
+
+#include <mutex>
+#include <atomic>
+#include <memory>
+#include <functional>
+
+#include "types.h"
+#include "HashMap.h"
+
+namespace Serialize {
+
+//Object ids shared by several Archives (Archive::Global, SetRegistry) saving or loading parts of one graph, usually
+//from several threads.  Saving, the first archive to reach a pointer claims its id and writes the object, the others
+//write a reference.  Loading, whichever archive meets an id first creates the object and the one holding its body fills
+//it in, so references across parts resolve without fix-ups; once every part is read Unresolved() must be 0.
+//Loaded objects are owned by the registry (one shared_ptr each) until Reset() or its end, shared_ptr fields share it.
+//A loader (SetLoader, e.g. IndexedReader) lets Materialize() fetch the body of an object only referenced so far.
+//Striped: each of STRIPES HashMaps has its own lock, picked by a hash of the pointer or id.
+class IdentityRegistry
+{
+public:
+    using ObjId = uint64;
+    enum { ID_NULL = 1, ID_START = 2, STRIPES = 64, };     //as Archive's
+
+    IdentityRegistry() = default;
+    IdentityRegistry(const IdentityRegistry&) = delete;
+    IdentityRegistry& operator=(const IdentityRegistry&) = delete;
+
+    ObjId Claim(const void* pObj, bool& bFirst)     //save: pObj's id, bFirst for the one archive to write it
+    {
+        Stripe& stripe = _stripes[Index(uint64(uintptr_t(pObj)) >> 4)];     //past the alignment bits
+        std::lock_guard<std::mutex> lock(stripe.mutex);
+        ObjId& objId = stripe.ids[(void*)pObj];
+        bFirst = !objId;
+        if(bFirst)
+            objId = _nextId++;
+        return objId;
+    }
+
+    //load: the object with objId, made by create() on first sight; bBody for the one archive filling it in, a second
+    //body for the same id (or create() failing) returns nullptr
+    template<typename Create>
+    std::shared_ptr<void> Acquire(ObjId objId, bool bBody, Create create)
+    {
+        Stripe& stripe = _stripes[Index(objId)];
+        std::lock_guard<std::mutex> lock(stripe.mutex);
+        Entry& entry = stripe.objs[objId];
+        if(!entry.shared)
+        {
+            if(!(entry.shared = create()))
+                return nullptr;
+            _created++;
+            if(!bBody)
+            {
+                std::lock_guard<std::mutex> lockReferenced(_referencedMutex);
+                _referenced.push_back(objId);
+            }
+        }
+        if(bBody)
+        {
+            if(entry.bBody)
+                return nullptr;
+            entry.bBody = true;
+            _bodies++;
+        }
+        return entry.shared;
+    }
+
+    std::shared_ptr<void> Find(ObjId objId, bool* pbBody = nullptr)
+    {
+        Stripe& stripe = _stripes[Index(objId)];
+        std::lock_guard<std::mutex> lock(stripe.mutex);
+        Entry* pEntry = stripe.objs.find(objId);
+        if(pbBody)
+            *pbBody = pEntry && pEntry->bBody;
+        return pEntry ? pEntry->shared : nullptr;
+    }
+    std::shared_ptr<void> Materialize(ObjId objId)      //the loaded object, its body fetched by the loader if need be
+    {
+        bool bBody = false;
+        std::shared_ptr<void> shared = Find(objId, &bBody);
+        if(bBody)
+            return shared;
+        if(!_loader || !_loader(objId))
+            return nullptr;
+        shared = Find(objId, &bBody);
+        return bBody ? shared : nullptr;
+    }
+    void SetLoader(std::function<bool(ObjId)> loader) { _loader = std::move(loader); }
+
+    std::vector<ObjId> TakeReferenced()     //ids first met as a reference, since the last call
+    {
+        std::lock_guard<std::mutex> lock(_referencedMutex);
+        std::vector<ObjId> referenced;
+        referenced.swap(_referenced);
+        return referenced;
+    }
+
+    uint64 Unresolved() const { return _created - _bodies; }    //referenced, but no body loaded (yet)
+    uint64 Objects() const    { return _created; }
+
+    void Reset()
+    {
+        for(Stripe& stripe : _stripes)
+        {
+            std::lock_guard<std::mutex> lock(stripe.mutex);
+            stripe.ids.clear();
+            stripe.objs.clear();
+        }
+        _nextId  = ID_START;
+        _created = 0;
+        _bodies  = 0;
+        TakeReferenced();
+    }
+
+private:
+    struct Entry
+    {
+        std::shared_ptr<void>   shared;
+        bool                    bBody = false;
+    };
+    struct Stripe
+    {
+        std::mutex              mutex;
+        HashMap<void*, ObjId>   ids;
+        HashMap<ObjId, Entry>   objs;
+    };
+
+    static size_t Index(uint64 bits) { return size_t((bits * 0x9E3779B97F4A7C15ULL) >> 58); }     //top 6 bits, STRIPES == 64
+
+    Stripe              _stripes[STRIPES];
+    std::atomic<ObjId>  _nextId{ID_START};
+    std::atomic<uint64> _created{0};
+    std::atomic<uint64> _bodies{0};
+    std::mutex          _referencedMutex;
+    std::vector<ObjId>  _referenced;
+    std::function<bool(ObjId)>  _loader;
+};
+
+}//namespace Serialize
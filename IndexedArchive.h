@@ -0,0 +1,282 @@
+#pragma once
+
+#include <map>
+
+#include "Archive.h"
+#include "IdentityRegistry.h"
+
+namespace Serialize {
+
+//shared_ptr<> field that an IndexedReader loads on first use instead of with its owner.  Elsewhere it is a plain
+//shared_ptr<>: saved and loaded eagerly, or, in Global archives, resolved through the registry when first used.
+//Not thread safe.  The registry owns the object holding the Lazy<>, so the Lazy<> does not own the registry: once the
+//reader (the registry's loader) is gone an unloaded Lazy<> gets nullptr on first use.
+template<typename Type>
+class Lazy
+{
+    std::shared_ptr<Type>               _ptr;
+    std::weak_ptr<IdentityRegistry>     _pRegistry;
+    IdentityRegistry::ObjId             _objId = 0;     //not 0 while not loaded
+
+public:
+    Lazy(std::shared_ptr<Type> ptr = nullptr) : _ptr(std::move(ptr)) {}
+
+    const std::shared_ptr<Type>& Get()
+    {
+        if(_objId)
+        {
+            if(std::shared_ptr<IdentityRegistry> pRegistry = _pRegistry.lock())
+                _ptr = std::dynamic_pointer_cast<Type>(std::static_pointer_cast<SerializableBase>(pRegistry->Materialize(_objId)));
+            _pRegistry.reset();
+            _objId = 0;
+        }
+        return _ptr;
+    }
+    Type* operator->() { return Get().get(); }
+    Type& operator*()  { return *Get(); }
+
+    bool IsLoaded() const { return !_objId; }
+    void Defer(const std::shared_ptr<IdentityRegistry>& pRegistry, IdentityRegistry::ObjId objId)     //Archive, body elsewhere
+    {
+        _ptr = nullptr;
+        _pRegistry = pRegistry;
+        _objId = objId;
+    }
+};
+
+//Random access container for object graphs.  Every Serializable object is a record of its own, a Global archive whose
+//pointers are references, followed by a footer indexing the records by ObjId and naming the roots:
+//  {record} [Compact archive: count {objId, offset, size}, count {name, objId}, CheckPoint] [uint64 footer offset][magic]
+//IndexedReader seeks to the records it needs: a root by name, or any object, with everything its pointers reach, except
+//through Lazy<> fields, which load their own subtree on first use.  The source must support seek() (files, memory).
+class IndexedWriter
+{
+public:
+    using ObjId = IdentityRegistry::ObjId;
+    enum : uint32 { MAGIC = 0x49445831, TRAILER_SIZE = sizeof(uint64) + sizeof(uint32), };     //"IDX1"
+
+    IndexedWriter(IDataSource& sink, uint32 format = Archive::Tagged)
+        : _sink(sink), _format(format | Archive::Global), _pRegistry(std::make_shared<IdentityRegistry>()) {}
+    ~IndexedWriter() { Close(); }
+
+    template<typename Type>
+    bool Save(const std::string& name, const std::shared_ptr<Type>& pRoot)     //pRoot, and the records of all it reaches
+    {
+        if(_bClosed || _bError)
+            return false;
+        bool bFirst = false;
+        ObjId objId = pRoot ? _pRegistry->Claim(pRoot.get(), bFirst) : ObjId(IdentityRegistry::ID_NULL);
+        _roots.emplace_back(name, objId);
+        if(bFirst)
+            _queue.push_back(pRoot.get());
+        while((_queuePos < _queue.size()) && !_bError)
+            Record(_queue[_queuePos++]);
+        _queue.clear();
+        _queuePos = 0;
+        return !_bError;
+    }
+    bool Close()        //the footer, once
+    {
+        if(_bClosed)
+            return !_bError;
+        _bClosed = true;
+        if(_bError)
+            return false;
+        MemorySource footer;
+        {
+            Archive arc(footer, Archive::SaveArchive, Archive::Compact);
+            uint64 count = _index.size();
+            arc << count;
+            for(Entry& entry : _index)
+                arc << entry.objId << entry.offset << entry.size;
+            count = _roots.size();
+            arc << count;
+            for(auto& root : _roots)
+                arc << root.first << root.second;
+            _bError = !arc.CheckPoint();
+        }
+        BYTE trailer[TRAILER_SIZE];
+        uint64 offset = ByteOrder(_offset);
+        uint32 magic  = ByteOrder(uint32(MAGIC));
+        std::memcpy(trailer, &offset, sizeof(offset));
+        std::memcpy(trailer + sizeof(offset), &magic, sizeof(magic));
+        _bError = _bError || !Write(footer.Buffer(), footer.Size()) || !Write(trailer, TRAILER_SIZE);
+        _sink.flush();
+        return !_bError;
+    }
+    bool IsError() const { return _bError; }
+
+private:
+    struct Entry
+    {
+        ObjId   objId;
+        uint64  offset;
+        uint64  size;
+    };
+
+    IDataSource&                        _sink;
+    uint32                              _format;
+    std::shared_ptr<IdentityRegistry>   _pRegistry;
+    std::vector<SerializableBase*>      _queue;         //claimed, [_queuePos, end) still to write
+    size_t                              _queuePos = 0;
+    std::vector<Entry>                  _index;
+    std::vector<std::pair<std::string, ObjId>> _roots;
+    MemorySource                        _record;        //the record being saved
+    uint64                              _offset  = 0;   //bytes written
+    bool                                _bClosed = false;
+    bool                                _bError  = false;
+
+    void Record(SerializableBase* pObj)
+    {
+        bool bFirst = false;
+        ObjId objId = _pRegistry->Claim(pObj, bFirst);
+        _record.Reset();
+        {
+            Archive arc(_record, Archive::SaveArchive, _format, 0);     //unbuffered, _record is memory
+            arc.SetRegistry(_pRegistry);
+            arc.SetRecord(pObj, &_queue);
+            arc << pObj;
+            _bError = !arc.CheckPoint();
+        }
+        _index.push_back({ objId, _offset, _record.Size() });
+        _bError = _bError || !Write(_record.Buffer(), _record.Size());
+    }
+    bool Write(const BYTE* pData, size_t size)
+    {
+        _offset += size;
+        while(size)
+        {
+            int32 ret = _sink.save((void*)pData, uint32(std::min<size_t>(size, 0x40000000)));
+            if(ret <= 0)
+                return false;
+            pData += ret;
+            size  -= size_t(ret);
+        }
+        return true;
+    }
+};
+
+class IndexedReader
+{
+public:
+    using ObjId = IdentityRegistry::ObjId;
+
+    IndexedReader(IDataSource& source) : _source(source), _pRegistry(std::make_shared<IdentityRegistry>())
+    {
+        _bError = !Open();
+        _pRegistry->SetLoader([this](ObjId objId) { return Materialize(objId); });
+    }
+    ~IndexedReader()        //loaded objects stay with the shared_ptrs the caller holds
+    {
+        _pRegistry->SetLoader(nullptr);
+        _pRegistry->Reset();
+    }
+    IndexedReader(const IndexedReader&) = delete;
+    IndexedReader& operator=(const IndexedReader&) = delete;
+
+    template<typename Type>
+    bool Load(const std::string& name, std::shared_ptr<Type>& ptr)
+    {
+        auto it = _roots.find(name);
+        if(it == _roots.end())
+            return ptr = nullptr, false;
+        return Load(it->second, ptr);
+    }
+    template<typename Type>
+    bool Load(ObjId objId, std::shared_ptr<Type>& ptr)     //the object, and all it reaches except through Lazy<>
+    {
+        ptr = nullptr;
+        if(objId == IdentityRegistry::ID_NULL)
+            return !_bError;
+        std::shared_ptr<void> shared = _pRegistry->Materialize(objId);
+        ptr = std::dynamic_pointer_cast<Type>(std::static_pointer_cast<SerializableBase>(shared));
+        return ptr != nullptr;
+    }
+
+    std::vector<std::string> Roots() const
+    {
+        std::vector<std::string> names;
+        for(auto& root : _roots)
+            names.push_back(root.first);
+        return names;
+    }
+    size_t Objects() const  { return _index.size(); }
+    uint64 Records() const  { return _records; }        //read so far
+    bool   IsError() const  { return _bError; }
+
+private:
+    IDataSource&                        _source;
+    std::shared_ptr<IdentityRegistry>   _pRegistry;
+    HashMap<ObjId, std::pair<uint64, uint64>> _index;   //objId: offset, size
+    std::map<std::string, ObjId>        _roots;
+    uint64                              _records = 0;
+    bool                                _bError  = false;
+
+    bool Open()
+    {
+        int64 size = _source.seek(0) ? _source.remaining() : -1;
+        BYTE trailer[IndexedWriter::TRAILER_SIZE];
+        if((size < IndexedWriter::TRAILER_SIZE) || !_source.seek(uint64(size) - IndexedWriter::TRAILER_SIZE) ||
+           (_source.load(trailer, IndexedWriter::TRAILER_SIZE) != IndexedWriter::TRAILER_SIZE))
+            return false;
+        uint64 offset;
+        uint32 magic;
+        std::memcpy(&offset, trailer, sizeof(offset));
+        std::memcpy(&magic, trailer + sizeof(offset), sizeof(magic));
+        if((ByteOrder(magic) != IndexedWriter::MAGIC) || ((offset = ByteOrder(offset)) > uint64(size)) || !_source.seek(offset))
+            return false;
+
+        Archive arc(_source, Archive::LoadArchive, Archive::Tagged);
+        uint64 count = 0;
+        arc >> count;
+        for(uint64 i = 0; (i < count) && !arc.IsError(); i++)
+        {
+            ObjId objId = 0;
+            uint64 recordOffset = 0, recordSize = 0;
+            arc >> objId >> recordOffset >> recordSize;
+            if((recordOffset > offset) || (recordSize > offset - recordOffset) || !objId)
+                return false;
+            _index[objId] = { recordOffset, recordSize };
+        }
+        arc >> count;
+        for(uint64 i = 0; (i < count) && !arc.IsError(); i++)
+        {
+            std::string name;
+            ObjId objId = 0;
+            arc >> name >> objId;
+            _roots[name] = objId;
+        }
+        return arc.CheckPoint();
+    }
+
+    bool Materialize(ObjId objId)       //objId's record, then the records of every object it references eagerly
+    {
+        if(_bError || !Read(objId))
+            return false;
+        for(std::vector<ObjId> referenced; !(referenced = _pRegistry->TakeReferenced()).empty(); )
+            for(ObjId id : referenced)
+            {
+                bool bBody = false;
+                _pRegistry->Find(id, &bBody);
+                if(!bBody && !Read(id))
+                    return false;
+            }
+        return true;
+    }
+    bool Read(ObjId objId)
+    {
+        std::pair<uint64, uint64>* pRecord = _index.find(objId);
+        if(!pRecord || !_source.seek(pRecord->first))
+            return false;
+        Archive arc(_source, Archive::LoadArchive, Archive::Tagged, uint32(std::min<uint64>(pRecord->second, Archive::BUFFER_SIZE)));   //no read ahead
+        arc.SetRegistry(_pRegistry);
+        std::shared_ptr<SerializableBase> ptr;
+        arc >> ptr;
+        bool bBody = false;
+        _pRegistry->Find(objId, &bBody);
+        _records++;
+        return arc.CheckPoint() && bBody;
+    }
+};
+
+}//namespace Serialize
@@ -0,0 +1,148 @@
+#pragma once
+
+#include "DataSource.h"
+
+#ifdef _MSC_VER
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+namespace Serialize {
+
+//Memory mapped file.  Load maps the whole file read-only and lends the mapping to Archive (view) so fields are copied
+//straight out of the page cache.  Save pre-sizes the file, doubles it when it fills up and trims it to the saved size.
+class MappedFileSource : public IDataSource
+{
+    BYTE*   _pData    = nullptr;
+    uint64  _capacity = 0;      //mapped bytes
+    uint64  _size     = 0;      //file size (load) or saved bytes (save)
+    uint64  _offset   = 0;
+    bool    _bSave    = false;
+    bool    _bOpen    = false;
+#ifdef _MSC_VER
+    HANDLE  _file     = INVALID_HANDLE_VALUE;
+    HANDLE  _mapping  = nullptr;
+#else
+    int     _file     = -1;
+#endif
+
+    virtual int32 save(void* pData, uint32 size)
+    {
+        if(!_bSave || !_pData) return -1;
+        if((_capacity - _offset < size) && !Map(std::max(_capacity * 2, _offset + size))) return -1;
+        std::memcpy(_pData + _offset, pData, size);
+        _size = _offset += size;
+        return size;
+    };
+    virtual int32 load(void* pData, uint32 size)
+    {
+        const BYTE* pView = view(size);
+        if(!pView) return -1;
+        std::memcpy(pData, pView, size);
+        return size;
+    };
+    virtual const BYTE* view(uint32& size)
+    {
+        if(_bSave || (_offset >= _size)) return nullptr;
+        size = uint32(std::min<uint64>(size, _size - _offset));
+        const BYTE* pView = _pData + _offset;
+        _offset += size;
+        return pView;
+    }
+    virtual bool  unload(uint32 size) { return (!_bSave && (size <= _offset)) ? (_offset -= size, true) : false; }
+    virtual int64 remaining() { return _bSave ? -1 : int64(_size - _offset); }
+    virtual bool  seek(uint64 offset) { return (!_bSave && (offset <= _size)) ? (_offset = offset, true) : false; }
+
+    bool Map(uint64 capacity)
+    {
+        Unmap();
+#ifdef _MSC_VER
+        LARGE_INTEGER li = {};
+        li.QuadPart = LONGLONG(capacity);
+        if(_bSave && !(::SetFilePointerEx(_file, li, nullptr, FILE_BEGIN) && ::SetEndOfFile(_file)))
+            return false;
+        _mapping = ::CreateFileMappingA(_file, nullptr, _bSave ? PAGE_READWRITE : PAGE_READONLY, li.HighPart, li.LowPart, nullptr);
+        if(_mapping)
+            _pData = (BYTE*)::MapViewOfFile(_mapping, _bSave ? FILE_MAP_WRITE : FILE_MAP_READ, 0, 0, SIZE_T(capacity));
+#else
+        if(_bSave && ::ftruncate(_file, off_t(capacity)))
+            return false;
+        void* p = ::mmap(nullptr, size_t(capacity), _bSave ? (PROT_READ | PROT_WRITE) : PROT_READ, MAP_SHARED, _file, 0);
+        if(p != MAP_FAILED)
+        {
+            _pData = (BYTE*)p;
+            if(!_bSave)
+                ::madvise(p, size_t(capacity), MADV_SEQUENTIAL);
+        }
+#endif
+        if(_pData)
+            _capacity = capacity;
+        return _pData != nullptr;
+    }
+    void Unmap()
+    {
+#ifdef _MSC_VER
+        if(_pData)   ::UnmapViewOfFile(_pData);
+        if(_mapping) ::CloseHandle(_mapping);
+        _mapping = nullptr;
+#else
+        if(_pData)   ::munmap(_pData, size_t(_capacity));
+#endif
+        _pData = nullptr;
+        _capacity = 0;
+    }
+
+public:
+    enum Mode { Load, Save, };
+    enum : uint64 { DEFAULT_SIZE = 1 << 20, };
+
+    MappedFileSource(const char* pFilename, const Mode mode = Save, uint64 size = DEFAULT_SIZE) : _bSave(mode == Save)
+    {
+#ifdef _MSC_VER
+        _file = ::CreateFileA(pFilename, _bSave ? (GENERIC_READ | GENERIC_WRITE) : GENERIC_READ, FILE_SHARE_READ, nullptr,
+                              _bSave ? CREATE_ALWAYS : OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if(_file == INVALID_HANDLE_VALUE) return;
+        LARGE_INTEGER li = {};
+        ::GetFileSizeEx(_file, &li);
+        _size = uint64(li.QuadPart);
+#else
+        _file = ::open(pFilename, _bSave ? (O_RDWR | O_CREAT | O_TRUNC) : O_RDONLY, 0644);
+        if(_file < 0) return;
+        struct stat st = {};
+        ::fstat(_file, &st);
+        _size = uint64(st.st_size);
+#endif
+        if(_bSave)
+            _bOpen = Map(size ? size : DEFAULT_SIZE);
+        else
+            _bOpen = !_size || Map(_size);
+    }
+    ~MappedFileSource()
+    {
+        Unmap();
+#ifdef _MSC_VER
+        if(_file == INVALID_HANDLE_VALUE) return;
+        if(_bSave)
+        {
+            LARGE_INTEGER li = {};
+            li.QuadPart = LONGLONG(_size);
+            ::SetFilePointerEx(_file, li, nullptr, FILE_BEGIN);
+            ::SetEndOfFile(_file);
+        }
+        ::CloseHandle(_file);
+#else
+        if(_file < 0) return;
+        if(_bSave)
+            (void)::ftruncate(_file, off_t(_size));     //trim the pre-sized file to what was saved
+        ::close(_file);
+#endif
+    }
+
+    bool   IsOpen() const { return _bOpen; }
+    uint64 Size() const   { return _size; }
+};
+
+}//namespace Serialize
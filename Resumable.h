@@ -0,0 +1,143 @@
+#pragma once
+
+#include "FrameSource.h"
+
+#if defined(__cpp_impl_coroutine) && defined(__has_include)
+#if __has_include(<coroutine>)
+#define SERIALIZE_COROUTINES 1
+#endif
+#endif
+
+#ifdef SERIALIZE_COROUTINES
+
+#include <coroutine>
+#include <exception>
+
+namespace Serialize {
+
+//Input pushed by its owner (a non-blocking socket's reads) instead of pulled, for loads without a thread per connection.
+//The stream is FrameSource messages.  A coroutine co_awaits Message(), suspending until the next whole message has
+//been Feed()'d, then loads it with an ordinary Archive: any overload works, none of them can run dry mid object.
+class IncrementalSource : public IDataSource
+{
+public:
+    class Awaiter
+    {
+        IncrementalSource&      _source;
+        std::coroutine_handle<> _handle;
+
+    public:
+        Awaiter(IncrementalSource& source) : _source(source) {}
+        Awaiter(const Awaiter&) = delete;
+        ~Awaiter() { if(_handle && (_source._waiting == _handle)) _source._waiting = nullptr; }    //frame destroyed while waiting
+
+        bool await_ready()                          { return _source.Next() || _source._bEnd; }
+        void await_suspend(std::coroutine_handle<> handle) { _source._waiting = _handle = handle; }
+        bool await_resume()                         { _handle = nullptr; return _source._bMessage; }   //false: stream ended
+    };
+
+    Awaiter Message() { return Awaiter(*this); }    //co_await: true once a whole message is buffered
+
+    void Feed(const void* pData, size_t size)       //resumes the waiting coroutine when its message is complete
+    {
+        if(_pos && (_pos >= _data.size() / 2))     //drop what was consumed, at most as much as is kept is moved
+        {
+            _data.erase(_data.begin(), _data.begin() + ptrdiff_t(_pos));
+            _pos = 0;
+        }
+        _data.insert(_data.end(), (const BYTE*)pData, (const BYTE*)pData + size);
+        if(_waiting && Next())
+            Resume();
+    }
+    void End()                                      //no more input, a waiting coroutine resumes with false
+    {
+        _bEnd = true;
+        if(_waiting && !Next())
+            Resume();
+    }
+
+    size_t Buffered() const { return _data.size() - _pos; }
+    bool   IsError() const  { return _bError; }
+
+private:
+    std::vector<BYTE>       _data;
+    size_t                  _pos      = 0;      //[_pos, _data.size()) not consumed
+    uint32                  _left     = 0;      //bytes of the current message not loaded yet
+    bool                    _bMessage = false;  //a message is current
+    bool                    _bEnd     = false;
+    bool                    _bError   = false;
+    std::coroutine_handle<> _waiting;
+
+    virtual int32 load(void* pData, uint32 size)    //never blocks: the current message is all buffered
+    {
+        size = std::min(size, _left);
+        if(!size)
+            return -1;
+        std::memcpy(pData, _data.data() + _pos, size);
+        _pos  += size;
+        _left -= size;
+        return int32(size);
+    }
+    virtual int32 save(void*, uint32) { return -1; }
+    virtual int64 remaining()         { return _left; }
+
+    bool Next()         //drop what is left of the current message, true once the next one is whole
+    {
+        if(_bMessage)
+        {
+            _pos += _left;
+            _left = 0;
+            _bMessage = false;
+        }
+        if(_bError || (Buffered() < FrameSource::HEADER_SIZE))
+            return false;
+        uint32 size = FrameSource::GetSize(_data.data() + _pos);
+        if(size > FrameSource::MAX_MESSAGE)
+        {
+            _bError = _bEnd = true;
+            return false;
+        }
+        if(Buffered() - FrameSource::HEADER_SIZE < size)
+            return false;
+        _pos += FrameSource::HEADER_SIZE;
+        _left = size;
+        return _bMessage = true;
+    }
+    void Resume()
+    {
+        std::coroutine_handle<> handle = _waiting;
+        _waiting = nullptr;
+        handle.resume();
+    }
+};
+
+//Coroutine return type for loaders: runs eagerly up to its first suspension, owns the frame.
+class Resumable
+{
+public:
+    struct promise_type
+    {
+        std::exception_ptr  _exception;
+
+        Resumable           get_return_object()     { return Resumable(std::coroutine_handle<promise_type>::from_promise(*this)); }
+        std::suspend_never  initial_suspend()       { return {}; }
+        std::suspend_always final_suspend() noexcept { return {}; }
+        void                return_void()           {}
+        void                unhandled_exception()   { _exception = std::current_exception(); }
+    };
+
+    Resumable(Resumable&& other) : _handle(other._handle) { other._handle = nullptr; }
+    Resumable& operator=(Resumable&& other) { std::swap(_handle, other._handle); return *this; }
+    ~Resumable() { if(_handle) _handle.destroy(); }
+
+    bool Done() const   { return !_handle || _handle.done(); }
+    void Rethrow() const { if(_handle && _handle.promise()._exception) std::rethrow_exception(_handle.promise()._exception); }
+
+private:
+    explicit Resumable(std::coroutine_handle<promise_type> handle) : _handle(handle) {}
+    std::coroutine_handle<promise_type> _handle;
+};
+
+}//namespace Serialize
+
+#endif //SERIALIZE_COROUTINES
@@ -4,6 +4,7 @@
 #include <memory>
 
 #include "types.h"
+#include "Arena.h"
 
 namespace Serialize {
 
@@ -12,17 +13,24 @@ class TypeInfo
 {
     static auto& Map() { static std::map<HASH, TypeInfo*> map; return map; }
 
-    using PFNCreate = SerializableBase * (*)();
+    using PFNCreate       = SerializableBase * (*)();
+    using PFNCreateShared = std::shared_ptr<SerializableBase> (*)(const std::shared_ptr<Arena>& pArena);
 public:
-    TypeInfo(const size_t hash, PFNCreate pfnCreate)
-        : _hash(HASH(hash)), _pfnCreate(pfnCreate) { Map()[_hash] = this; }
+    TypeInfo(const size_t hash, PFNCreate pfnCreate, PFNCreateShared pfnCreateShared)
+        : _hash(HASH(hash)), _pfnCreate(pfnCreate), _pfnCreateShared(pfnCreateShared) { Map()[_hash] = this; }
     SerializableBase*   Create() const  { return _pfnCreate(); }
+    std::shared_ptr<SerializableBase> CreateShared(const std::shared_ptr<Arena>& pArena) const { return _pfnCreateShared(pArena); }
     const HASH          Hash() const    { return _hash; };
-    static TypeInfo*    Find(HASH hash) { return Map()[hash]; }
+    static TypeInfo*    Find(HASH hash)     //no insert: safe from concurrent loads once static init is done
+    {
+        auto it = Map().find(hash);
+        return (it != Map().end()) ? it->second : nullptr;
+    }
 
 private:
-    HASH        _hash;
-    PFNCreate   _pfnCreate;
+    HASH            _hash;
+    PFNCreate       _pfnCreate;
+    PFNCreateShared _pfnCreateShared;
 };
 
 class Archive;
@@ -44,6 +52,12 @@ class Serializable : public Base
     friend class Archive;
     static const TypeInfo           s_typeinfo;
     static SerializableBase*        Create()            { return new Type; }
+    static std::shared_ptr<SerializableBase> CreateShared(const std::shared_ptr<Arena>& pArena)  //object and control block in one allocation
+    {
+        if(pArena)
+            return std::allocate_shared<Type>(ArenaAllocator<Type>(pArena));
+        return std::make_shared<Type>();
+    }
     virtual const TypeInfo*         GetTypeInfo() const { return &s_typeinfo; }
 protected:
     virtual bool IsOfType(HASH hash) const
@@ -56,6 +70,6 @@ protected:
     template<typename... Types>     Serializable(Types&& ...args) : Base(args ...) {}
 };
 template<class Type, class Base>
-const TypeInfo Serializable<Type, Base>::s_typeinfo(typeid(Type).hash_code(), Create);
+const TypeInfo Serializable<Type, Base>::s_typeinfo(typeid(Type).hash_code(), Create, CreateShared);
 
 } //namespace Serialize
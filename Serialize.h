@@ -4,6 +4,12 @@
 
 #include "Serializable.h"
 #include "DataSource.h"
+#include "MappedSource.h"
+#include "CompressSource.h"
+#include "FrameSource.h"
+#include "ShardedArchive.h"
+#include "IndexedArchive.h"
+#include "Resumable.h"
 
 #include "Archive.h"
 
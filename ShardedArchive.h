@@ -0,0 +1,213 @@
+#pragma once
+
+#include <future>
+
+#include "Archive.h"
+#include "ThreadPool.h"
+
+namespace Serialize {
+
+//Independent roots (a forest) saved and loaded on a thread pool.  The roots are split into contiguous shards, each saved
+//by its own Archive into memory, with its own id space and running hash (CheckPoint at the end of the shard), then
+//written out behind a directory:
+//  [magic][format][shard count] {[bytes][roots]} per shard, big-endian, then the shards back to back.
+//Loading reads the directory and hands each shard to the pool as soon as its bytes are in (in place when the source is
+//memory backed), then collects the roots in order.
+//Objects are only shared within a shard: a pointee reachable from roots in two shards is saved, and loaded, twice.
+//Unless the format is Global with an IdentityRegistry (SetRegistry) shared by the shards, then each object is saved
+//once, by whichever shard reaches it first, and a load fails if a reference was never matched by a body.
+class ShardedArchive
+{
+public:
+    enum : uint32 { MAGIC = 0x53485244, MAX_SHARDS = 1 << 16, };   //"SHRD"
+
+    ShardedArchive(IDataSource& source, ThreadPool& pool, uint32 format = Archive::Legacy)
+        : _source(source), _pool(pool), _format(format) {}
+
+    template<typename Type> bool Save(std::vector<Type>& roots, uint32 shards = 0);    //0 == 4 per pool thread
+    template<typename Type> bool Load(std::vector<Type>& roots);
+
+    void SetRegistry(std::shared_ptr<IdentityRegistry> pRegistry) { _pRegistry = std::move(pRegistry); }
+    bool IsError() const { return _bError; }
+
+private:
+    enum { HEAD_SIZE = 3 * sizeof(uint32), ENTRY_SIZE = 2 * sizeof(uint64), PIECE_SIZE = 0x40000000, CHUNK_SIZE = 0x00100000, };
+
+    IDataSource&    _source;
+    ThreadPool&     _pool;
+    uint32          _format;
+    bool            _bError = false;
+    std::shared_ptr<IdentityRegistry>   _pRegistry;
+
+    template<typename Type> static void Put(std::vector<BYTE>& data, Type value)
+    {
+        value = ByteOrder(value);
+        data.insert(data.end(), (BYTE*)&value, (BYTE*)&value + sizeof(value));
+    }
+    template<typename Type> static Type Get(const BYTE*& pData)
+    {
+        Type value;
+        std::memcpy(&value, pData, sizeof(value));
+        pData += sizeof(value);
+        return ByteOrder(value);
+    }
+
+    bool Write(const BYTE* pData, uint64 size)
+    {
+        while(size)
+        {
+            int32 ret = _source.save((void*)pData, uint32(std::min<uint64>(size, PIECE_SIZE)));
+            if(ret <= 0)
+                return false;
+            pData += ret;
+            size  -= uint64(ret);
+        }
+        return true;
+    }
+    bool Read(BYTE* pData, uint64 size)
+    {
+        while(size)
+        {
+            int32 ret = _source.load(pData, uint32(std::min<uint64>(size, PIECE_SIZE)));
+            if(ret <= 0)
+                return false;
+            pData += ret;
+            size  -= uint64(ret);
+        }
+        return true;
+    }
+    const BYTE* Take(uint64 size, std::vector<BYTE>& copy)     //size bytes in place from a memory backed source, else copied
+    {
+        if(!size)
+            return (const BYTE*)"";
+        int64 remaining = _source.remaining();
+        if((size > SIZE_MAX) || ((remaining >= 0) && (size > uint64(remaining))))
+            return nullptr;
+        copy.clear();
+        if(size <= PIECE_SIZE)
+        {
+            uint32 count = uint32(size);
+            if(const BYTE* pView = _source.view(count))
+            {
+                if(count == size)
+                    return pView;
+                copy.assign(pView, pView + count);      //short view, the rest is read
+            }
+        }
+        size_t chunk = (remaining >= 0) ? size_t(size) : size_t(CHUNK_SIZE);    //size is untrusted, grow as the data arrives
+        for(size_t have = copy.size(); have < size; have = copy.size())
+        {
+            copy.resize(have + std::min<size_t>(size_t(size) - have, chunk));
+            if(!Read(copy.data() + have, copy.size() - have))
+                return nullptr;
+        }
+        return copy.data();
+    }
+};
+
+template<typename Type>
+bool ShardedArchive::Save(std::vector<Type>& roots, uint32 shards)
+{
+    if(_bError)
+        return false;
+    if(!shards)
+        shards = 4 * _pool.Size();
+    shards = uint32(std::max<size_t>(1, std::min<size_t>({ shards, roots.size(), MAX_SHARDS })));
+
+    std::vector<MemorySource> outs(shards);
+    std::vector<std::future<bool>> done;
+    for(uint32 n = 0; n < shards; n++)
+    {
+        size_t begin = roots.size() * n / shards;
+        size_t end   = roots.size() * (n + 1) / shards;
+        done.push_back(_pool.Submit([this, &roots, &outs, n, begin, end]
+        {
+            Archive arc(outs[n], Archive::SaveArchive, _format);
+            arc.SetRegistry(_pRegistry);
+            for(size_t i = begin; i < end; i++)
+                arc << roots[i];
+            return arc.CheckPoint();
+        }));
+    }
+    bool bOk = true;
+    for(std::future<bool>& shard : done)
+        bOk = shard.get() && bOk;
+
+    std::vector<BYTE> directory;
+    Put(directory, uint32(MAGIC));
+    Put(directory, _format);
+    Put(directory, shards);
+    for(uint32 n = 0; n < shards; n++)
+    {
+        Put(directory, uint64(outs[n].Size()));
+        Put(directory, uint64(roots.size() * (n + 1) / shards - roots.size() * n / shards));
+    }
+    bOk = bOk && Write(directory.data(), directory.size());
+    for(uint32 n = 0; bOk && (n < shards); n++)
+        bOk = Write(outs[n].Buffer(), outs[n].Size());
+    _source.flush();
+    _bError = !bOk;
+    return bOk;
+}
+
+template<typename Type>
+bool ShardedArchive::Load(std::vector<Type>& roots)
+{
+    roots.clear();
+    if(_bError)
+        return false;
+    BYTE head[HEAD_SIZE];
+    const BYTE* pHead = head;
+    if(!Read(head, HEAD_SIZE) || (Get<uint32>(pHead) != MAGIC))
+        return !(_bError = true);
+    uint32 format = Get<uint32>(pHead);
+    uint32 shards = Get<uint32>(pHead);
+    if(shards > MAX_SHARDS)
+        return !(_bError = true);
+    std::vector<BYTE> directory(size_t(shards) * ENTRY_SIZE);
+    if(!Read(directory.data(), directory.size()))
+        return !(_bError = true);
+
+    std::vector<uint64> sizes(shards), counts(shards);
+    const BYTE* pEntry = directory.data();
+    for(uint32 n = 0; n < shards; n++)
+    {
+        sizes[n]  = Get<uint64>(pEntry);
+        counts[n] = Get<uint64>(pEntry);
+        if(counts[n] > sizes[n])                //every root takes at least a byte
+            return !(_bError = true);
+    }
+
+    std::vector<std::vector<BYTE>> copies(shards);
+    std::vector<std::vector<Type>> parts(shards);
+    std::vector<std::future<bool>> done;
+    bool bOk = true;
+    for(uint32 n = 0; bOk && (n < shards); n++)     //earlier shards decode while later ones are read
+    {
+        const BYTE* pShard = Take(sizes[n], copies[n]);
+        if(!(bOk = (pShard != nullptr)))
+            break;
+        done.push_back(_pool.Submit([this, &parts, format, pShard, size = sizes[n], count = counts[n], n]
+        {
+            SpanSource in(pShard, size_t(size));
+            Archive arc(in, Archive::LoadArchive, format);
+            arc.SetRegistry(_pRegistry);
+            parts[n].reserve(size_t(std::min<uint64>(count, CHUNK_SIZE)));     //count is untrusted, grow as roots load
+            for(uint64 i = 0; (i < count) && !arc.IsError(); i++)
+            {
+                parts[n].emplace_back();
+                arc >> parts[n].back();
+            }
+            return arc.CheckPoint();
+        }));
+    }
+    for(std::future<bool>& shard : done)
+        bOk = shard.get() && bOk;
+    bOk = bOk && (!_pRegistry || !_pRegistry->Unresolved());
+    _bError = !bOk;
+    for(uint32 n = 0; bOk && (n < shards); n++)
+        roots.insert(roots.end(), std::make_move_iterator(parts[n].begin()), std::make_move_iterator(parts[n].end()));
+    return bOk;
+}
+
+}//namespace Serialize
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <deque>
+#include <memory>
+#include <algorithm>
+#include <vector>
+#include <mutex>
+#include <thread>
+#include <future>
+#include <functional>
+#include <condition_variable>
+
+#include "types.h"
+
+namespace Serialize {
+
+//Fixed set of worker threads running submitted jobs in FIFO order.  Submit() returns a future for the job's result.
+class ThreadPool
+{
+public:
+    explicit ThreadPool(uint32 threads = 0)     //0 == one per hardware thread
+    {
+        if(!threads)
+            threads = std::max(1u, std::thread::hardware_concurrency());
+        for(uint32 i = 0; i < threads; i++)
+            _threads.emplace_back([this]{ Run(); });
+    }
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+    ~ThreadPool()
+    {
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _bStop = true;
+        }
+        _cv.notify_all();
+        for(std::thread& thread : _threads)
+            thread.join();
+    }
+
+    template<typename Func>
+    auto Submit(Func func) -> std::future<decltype(func())>
+    {
+        using Result = decltype(func());
+        auto pTask = std::make_shared<std::packaged_task<Result()>>(std::move(func));
+        std::future<Result> future = pTask->get_future();
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _jobs.emplace_back([pTask]{ (*pTask)(); });
+        }
+        _cv.notify_one();
+        return future;
+    }
+    uint32 Size() const { return uint32(_threads.size()); }
+
+private:
+    void Run()
+    {
+        for(;;)
+        {
+            std::function<void()> job;
+            {
+                std::unique_lock<std::mutex> lock(_mutex);
+                _cv.wait(lock, [this]{ return _bStop || !_jobs.empty(); });
+                if(_jobs.empty())
+                    return;     //stopping, and nothing left to run
+                job = std::move(_jobs.front());
+                _jobs.pop_front();
+            }
+            job();
+        }
+    }
+
+    std::vector<std::thread>            _threads;
+    std::deque<std::function<void()>>   _jobs;
+    std::mutex                          _mutex;
+    std::condition_variable             _cv;
+    bool                                _bStop = false;
+};
+
+}//namespace Serialize
@@ -0,0 +1,172 @@
+#pragma once
+
+#include <vector>
+#include <cstring>
+
+#include "types.h"
+#include "Checksum.h"
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#endif
+
+namespace Serialize {
+
+//pDest = pSrc ^ pKey, pDest may be pSrc
+inline void XorBytes(BYTE* pDest, const BYTE* pSrc, const BYTE* pKey, size_t size)
+{
+    size_t n = 0;
+#if defined(__AVX2__)
+    for(; n + 32 <= size; n += 32)
+    {
+        __m256i data = _mm256_loadu_si256((const __m256i*)(pSrc + n));
+        __m256i key  = _mm256_loadu_si256((const __m256i*)(pKey + n));
+        _mm256_storeu_si256((__m256i*)(pDest + n), _mm256_xor_si256(data, key));
+    }
+#endif
+#if defined(__AVX2__) || defined(__SSE2__) || defined(_M_X64)
+    for(; n + 16 <= size; n += 16)
+    {
+        __m128i data = _mm_loadu_si128((const __m128i*)(pSrc + n));
+        __m128i key  = _mm_loadu_si128((const __m128i*)(pKey + n));
+        _mm_storeu_si128((__m128i*)(pDest + n), _mm_xor_si128(data, key));
+    }
+#endif
+    for(; n + sizeof(uint64) <= size; n += sizeof(uint64))
+    {
+        uint64 data, key;
+        std::memcpy(&data, pSrc + n, sizeof(data));
+        std::memcpy(&key,  pKey + n, sizeof(key));
+        data ^= key;
+        std::memcpy(pDest + n, &data, sizeof(data));
+    }
+    for(; n < size; n++)
+        pDest[n] = pSrc[n] ^ pKey[n];
+}
+//pDest = pSrc ^ mask, pDest may be pSrc
+inline void XorBytes(BYTE* pDest, const BYTE* pSrc, BYTE mask, size_t size)
+{
+    size_t n = 0;
+#if defined(__AVX2__)
+    const __m256i mask256 = _mm256_set1_epi8(char(mask));
+    for(; n + 32 <= size; n += 32)
+        _mm256_storeu_si256((__m256i*)(pDest + n), _mm256_xor_si256(_mm256_loadu_si256((const __m256i*)(pSrc + n)), mask256));
+#endif
+#if defined(__AVX2__) || defined(__SSE2__) || defined(_M_X64)
+    const __m128i mask128 = _mm_set1_epi8(char(mask));
+    for(; n + 16 <= size; n += 16)
+        _mm_storeu_si128((__m128i*)(pDest + n), _mm_xor_si128(_mm_loadu_si128((const __m128i*)(pSrc + n)), mask128));
+#endif
+    const uint64 mask64 = mask * 0x0101010101010101ULL;
+    for(; n + sizeof(uint64) <= size; n += sizeof(uint64))
+    {
+        uint64 data;
+        std::memcpy(&data, pSrc + n, sizeof(data));
+        data ^= mask64;
+        std::memcpy(pDest + n, &data, sizeof(data));
+    }
+    for(; n < size; n++)
+        pDest[n] = pSrc[n] ^ mask;
+}
+
+//Byte stream transform for FilterSource.  Both ends see the same bytes in the same order, so stateful transforms
+//(keystreams, running checksums) stay in step.
+class ITransform
+{
+public:
+    virtual ~ITransform() = default;
+    virtual void encode(BYTE* pDest, const BYTE* pSrc, uint32 size) = 0;    //save, pDest may be pSrc
+    virtual void decode(BYTE* pData, uint32 size) = 0;                      //load, in place
+    virtual bool modifies() const { return true; }                          //false: saves skip encode and the copy
+    virtual void observe(const BYTE* /*pData*/, uint32 /*size*/) {}         //save when !modifies(), bytes read only
+};
+
+class XorTransform : public ITransform
+{
+    BYTE _mask = 0;
+
+public:
+    XorTransform(BYTE mask = 0) : _mask(mask) {}
+    void SetMask(BYTE mask) { _mask = mask; }
+
+    virtual void encode(BYTE* pDest, const BYTE* pSrc, uint32 size) { XorBytes(pDest, pSrc, _mask, size); }
+    virtual void decode(BYTE* pData, uint32 size)                   { XorBytes(pData, pData, _mask, size); }
+    virtual bool modifies() const                                   { return _mask != 0; }
+};
+
+//Xor with a keystream, Keystream() supplies the next bytes of it.
+class KeystreamTransform : public ITransform
+{
+    enum { KEY_SIZE = 4096, };
+    BYTE _key[KEY_SIZE];
+
+protected:
+    virtual void Keystream(BYTE* pKey, uint32 size) = 0;
+
+public:
+    virtual void encode(BYTE* pDest, const BYTE* pSrc, uint32 size)
+    {
+        while(size)
+        {
+            uint32 count = (size < KEY_SIZE) ? size : uint32(KEY_SIZE);
+            Keystream(_key, count);
+            XorBytes(pDest, pSrc, _key, count);
+            pDest += count;
+            pSrc  += count;
+            size  -= count;
+        }
+    }
+    virtual void decode(BYTE* pData, uint32 size) { encode(pData, pData, size); }
+};
+
+//xorshift64* keystream from a shared seed: obfuscation, not encryption
+class XorShiftTransform : public KeystreamTransform
+{
+    uint64 _state;
+    uint64 _word = 0;
+    uint32 _used = sizeof(uint64);      //bytes of _word already handed out
+
+protected:
+    virtual void Keystream(BYTE* pKey, uint32 size)
+    {
+        for(; size; size--)
+        {
+            if(_used == sizeof(uint64))
+            {
+                _state ^= _state >> 12;
+                _state ^= _state << 25;
+                _state ^= _state >> 27;
+                _word = _state * 0x2545F4914F6CDD1DULL;
+                _used = 0;
+            }
+            *pKey++ = BYTE(_word >> (8 * _used++));
+        }
+    }
+
+public:
+    XorShiftTransform(uint64 seed) : _state(seed ? seed : 0x9E3779B97F4A7C15ULL) {}
+};
+
+//Pass-through, CRC-32C of the bytes seen, compare the two ends' Crc() to check a transfer
+class ChecksumTransform : public ITransform
+{
+    uint32 _crc = 0xFFFFFFFF;
+
+public:
+    virtual void encode(BYTE* pDest, const BYTE* pSrc, uint32 size)
+    {
+        _crc = Crc32c::Update(_crc, pSrc, size);
+        if(pDest != pSrc)
+            std::memcpy(pDest, pSrc, size);
+    }
+    virtual void decode(BYTE* pData, uint32 size) { _crc = Crc32c::Update(_crc, pData, size); }
+    virtual bool modifies() const                 { return false; }
+    virtual void observe(const BYTE* pData, uint32 size) { _crc = Crc32c::Update(_crc, pData, size); }
+
+    uint32 Crc() const { return ~_crc; }
+    void   Reset()     { _crc = 0xFFFFFFFF; }
+};
+
+}//namespace Serialize
@@ -65,6 +65,8 @@ public:
         _pPodStruct = new PodStruct;
         _pUniquePodStruct = std::make_unique<PodStruct>();
         _pSharedPodStruct = std::make_shared<PodStruct>();
+        _stdArrayOfPtrs = { _pPodStruct, nullptr };
+        _stdVectorOfPtrs = { _pSerClass, nullptr, _pSerClass };
 
         Util::Rand rand;
         for(int i = rand.get(25, 15); i != 0; i--)
@@ -95,13 +97,16 @@ public:
             arc << _serClass       << _pSerClass       << _pSerClass_NULL  << _aSerClass  << _pUniqueSerClass  << _pSharedSerClass;
             arc << _podStruct      << _pPodStruct      << _pPodStruct_NULL << _aPodStruct << _pUniquePodStruct << _pSharedPodStruct;
             arc << _stdArrayOfInts << _stdVectorOfInts << _stdListOfInts   << _stdMapIntToInt;
+            arc << _stdArrayOfPtrs << _stdVectorOfPtrs;
         }
         else
         {
+            _stdArrayOfPtrs = {};   //aliases, _pPodStruct owns
             arc >> _cData          >> _iData           >> _double          >> _aChars     >> _aInts            >> _aDoubles;
             arc >> _serClass       >> _pSerClass       >> _pSerClass_NULL  >> _aSerClass  >> _pUniqueSerClass  >> _pSharedSerClass;
             arc >> _podStruct      >> _pPodStruct      >> _pPodStruct_NULL >> _aPodStruct >> _pUniquePodStruct >> _pSharedPodStruct;
             arc >> _stdArrayOfInts >> _stdVectorOfInts >> _stdListOfInts   >> _stdMapIntToInt;
+            arc >> _stdArrayOfPtrs >> _stdVectorOfPtrs;
         }
     }
 
@@ -115,7 +120,10 @@ protected:
         os << " A:(" << _stdArrayOfInts.size()  << "){";     for(auto& item : _stdArrayOfInts)  os << item << ",";                                     os << "},";
         os << " V:(" << _stdVectorOfInts.size() << "){";     for(auto& item : _stdVectorOfInts) os << item << ",";                                     os << "},";
         os << " L:(" << _stdListOfInts.size()   << "){";     for(auto& item : _stdListOfInts)   os << item << "->";                                    os << "},";
-        os << " M:(" << _stdMapIntToInt.size()  << "){";     for(auto& pair : _stdMapIntToInt)  os << "{" << pair.first << "," << pair.second << "},"; os << "}";
+        os << " M:(" << _stdMapIntToInt.size()  << "){";     for(auto& pair : _stdMapIntToInt)  os << "{" << pair.first << "," << pair.second << "},"; os << "},";
+        bool bPtrs = (_stdArrayOfPtrs[0] == _pPodStruct) && !_stdArrayOfPtrs[1] && (_stdVectorOfPtrs.size() == 3) &&
+                     (_stdVectorOfPtrs[0] == _pSerClass) && !_stdVectorOfPtrs[1] && (_stdVectorOfPtrs[2] == _pSerClass);
+        os << " P:" << (bPtrs ? "ok" : "BAD");
         return os;
     }
 
@@ -144,6 +152,8 @@ protected:
     std::vector<int32>          _stdVectorOfInts;
     std::list<int32>            _stdListOfInts;
     std::map<int32, int32>      _stdMapIntToInt;
+    std::array<PodStruct*, 2>   _stdArrayOfPtrs = {};
+    std::vector<SerClass*>      _stdVectorOfPtrs;       //aliases, _pSerClass owns
 };
 
 AllTypes::shared_ptr GenerateAllTypesTree()
@@ -161,6 +171,54 @@ AllTypes::shared_ptr GenerateAllTypesTree()
                     AllTypes::make_shared('p', 20)));
 }
 
+template<typename Type> std::vector<BYTE> Saved(Type& obj, uint32 format)
+{
+    MemorySource out;
+    Archive arc(out, Archive::SaveArchive, format);
+    arc << obj;
+    arc.CheckPoint();
+    return out.GetData();
+}
+
+void CompactIntegers()  //Compact saves wide integers as Dints, zigzag encoded when signed, and loads them back exactly
+{
+    std::vector<int64>  sints = { 0, -1, 1, -2, 63, -64, -300, 1 << 20, -(int64(1) << 40), INT64_MAX, INT64_MIN, };
+    std::vector<uint32> uints = { 0, 127, 128, 0xFFFFFFFF, };
+    int64  negative = -1234567890123;
+    int16  small    = -7;
+    MemorySource legacy, wire;
+    for(auto* pOut : { &legacy, &wire })
+    {
+        Archive arc(*pOut, Archive::SaveArchive, (pOut == &wire) ? Archive::Compact : Archive::Legacy);
+        arc << sints << uints << negative << small;
+        arc.CheckPoint();
+    }
+    std::vector<int64>  sintsIn;
+    std::vector<uint32> uintsIn;
+    int64 negativeIn = 0;
+    int16 smallIn    = 0;
+    Archive arc(wire, Archive::LoadArchive, Archive::Compact);
+    arc >> sintsIn >> uintsIn >> negativeIn >> smallIn;
+    bool bOk = arc.CheckPoint() && (sintsIn == sints) && (uintsIn == uints) && (negativeIn == negative) && (smallIn == small);
+    std::cout << "Integers, Legacy " << legacy.Size() << " bytes, Compact " << wire.Size() << " bytes, reloaded: "
+              << (bOk ? "ok" : "FAILED") << "\n";
+
+    std::shared_ptr<Node> pTree = GenerateAllTypesTree();
+    std::shared_ptr<Node> pIn;
+    MemorySource compact;
+    {
+        Archive arc(compact, Archive::SaveArchive, Archive::Compact);
+        arc << pTree;
+        arc.CheckPoint();
+        Archive in(compact, Archive::LoadArchive, Archive::Compact);
+        in >> pIn;
+        bOk = in.CheckPoint() && pIn;
+    }
+    bOk = bOk && (Saved(pIn, Archive::Compact) == compact.GetData());   //the loaded tree saves to the same bytes
+    std::cout << "AllTypes Tree, Legacy " << Saved(pTree, Archive::Legacy).size() << " bytes, Compact " << compact.Size()
+              << " bytes, reloaded: " << (bOk ? "ok" : "FAILED") << "\n";
+}
+
 int main()
 {
     {
@@ -185,6 +243,35 @@ int main()
         std::cout << Util::DrawTree<decltype(pIn)>(pIn, true) << "\n";
     }
 
+    {
+        std::shared_ptr<Node> pOut = GenerateAllTypesTree();
+        {
+            MappedFileSource file("test.map", MappedFileSource::Save, 64);     //small, the mapping grows as it fills
+            Archive arc(file);
+            arc << pOut;
+            arc.CheckPoint();
+        }
+        std::shared_ptr<Node> pIn;
+        bool bOk = false;
+        {
+            MappedFileSource file("test.map", MappedFileSource::Load);
+            Archive arc(file);
+            arc >> pIn;
+            bOk = arc.CheckPoint() && pIn;
+        }
+        MemorySource saved, loaded;     //the loaded tree saves to the same bytes as the original
+        {
+            Archive arc(saved);
+            arc << pOut;
+            Archive check(loaded);
+            check << pIn;
+        }
+        bOk = bOk && (saved.GetData() == loaded.GetData());
+        std::cout << "AllTypes Tree through MappedFileSource: " << (bOk ? "ok" : "FAILED") << "\n";
+    }
+
+    CompactIntegers();
+
     return 0;
 }
 
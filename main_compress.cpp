@@ -0,0 +1,234 @@
+
+#include <iostream>
+
+#include "util.h"
+#include "Serialize.h"
+
+using namespace Serialize;
+
+class Record : public Serializable<Record>
+{
+    using Base = Serializable;
+public:
+    using shared_ptr = std::shared_ptr<Record>;
+
+    Record(int32 id = 0) : _id(id), _name("record " + std::to_string(id / 10)), _samples(64, id % 7) {}
+    void Serialize(Archive& arc)
+    {
+        Base::Serialize(arc);
+        arc.Serialize(_id);
+        arc.Serialize(_name);
+        arc.Serialize(_samples);
+    }
+    bool operator==(const Record& rhs) const { return (_id == rhs._id) && (_name == rhs._name) && (_samples == rhs._samples); }
+
+protected:
+    int32               _id;
+    std::string         _name;
+    std::vector<int32>  _samples;
+};
+
+enum { RECORDS = 20000, BLOCK = 64 * 1024, };
+
+std::vector<Record::shared_ptr> GenerateRecords()
+{
+    std::vector<Record::shared_ptr> records;
+    for(int32 i = 0; i < RECORDS; i++)
+        records.push_back(std::make_shared<Record>(i));
+    return records;
+}
+
+bool SameRecords(const std::vector<Record::shared_ptr>& lhs, const std::vector<Record::shared_ptr>& rhs)
+{
+    if(lhs.size() != rhs.size())
+        return false;
+    for(size_t i = 0; i < lhs.size(); i++)
+        if(!lhs[i] || !rhs[i] || !(*lhs[i] == *rhs[i]))
+            return false;
+    return true;
+}
+
+bool LoadRecords(IDataSource& source, std::vector<Record::shared_ptr>& records)
+{
+    CompressSource unpacked(source);
+    Archive arc(unpacked, Archive::LoadArchive);
+    arc >> records;
+    return arc.CheckPoint() && !unpacked.IsError();
+}
+
+void LzRoundTrip()      //the block codec alone, at every level, and incompressible input left to be stored
+{
+    std::vector<BYTE> text;
+    for(int i = 0; text.size() < 200000; i++)
+    {
+        std::string line = "line " + std::to_string(i % 500) + ": the quick brown fox\n";
+        text.insert(text.end(), line.begin(), line.end());
+    }
+    Lz lz;
+    bool bOk = true;
+    std::vector<BYTE> packed(Lz::Bound(uint32(text.size()))), unpacked(text.size());
+    for(int level : { Lz::Fast, Lz::Default, Lz::Best })
+    {
+        uint32 size = lz.Compress(text.data(), uint32(text.size()), packed.data(), uint32(packed.size()), level);
+        int32 raw   = Lz::Decompress(packed.data(), size, unpacked.data(), uint32(unpacked.size()));
+        bOk = bOk && size && (raw == int32(text.size())) && (unpacked == text);
+        std::cout << "Lz level " << level << ": " << text.size() << " -> " << size << " bytes\n";
+    }
+    Util::Rand rand;
+    std::vector<BYTE> noise(4096);
+    for(BYTE& u8 : noise)
+        u8 = BYTE(rand.get(255));
+    bOk = bOk && !lz.Compress(noise.data(), uint32(noise.size()), packed.data(), uint32(noise.size()) - 1);     //does not shrink
+    std::cout << "Lz round trip: " << (bOk ? "ok" : "FAILED") << "\n\n";
+}
+
+void CompressedArchive()    //records saved through CompressSource, loaded back, then a truncated and a corrupted copy refused
+{
+    std::vector<Record::shared_ptr> records = GenerateRecords();
+    MemorySource raw, packed;
+    {
+        Archive arc(raw);
+        arc << records;
+    }
+    {
+        CompressSource compress(packed, Lz::Default, BLOCK);
+        Archive arc(compress);
+        arc << records;
+        arc.CheckPoint();
+    }
+    std::vector<Record::shared_ptr> loaded;
+    bool bOk = LoadRecords(packed, loaded) && SameRecords(records, loaded);
+    std::cout << "CompressSource: " << RECORDS << " records, " << raw.Size() << " bytes raw, " << packed.Size()
+              << " compressed: " << (bOk ? "ok" : "FAILED") << "\n";
+
+    std::vector<BYTE> bytes = packed.GetData();
+    MemorySource truncated(std::vector<BYTE>(bytes.begin(), bytes.end() - bytes.size() / 3));
+    bool bTruncated = !LoadRecords(truncated, loaded);
+    std::cout << "  truncated to " << truncated.Size() << " bytes: " << (bTruncated ? "refused, ok" : "loaded, FAILED") << "\n";
+
+    bytes[bytes.size() / 2] ^= 0x5A;
+    MemorySource corrupted(bytes);
+    bool bCorrupted = !LoadRecords(corrupted, loaded);
+    std::cout << "  a byte corrupted: " << (bCorrupted ? "refused, ok" : "loaded, FAILED") << "\n\n";
+}
+
+template<typename Saver, typename Loader>
+bool Pairing(std::vector<Record::shared_ptr>& records, ThreadPool& pool)    //saved by one codec, loaded by the other
+{
+    MemorySource packed;
+    {
+        Saver compress(packed, pool);
+        Archive arc(compress);
+        arc << records;
+        arc.CheckPoint();
+    }
+    Loader unpacked(packed, pool);
+    Archive arc(unpacked, Archive::LoadArchive);
+    std::vector<Record::shared_ptr> loaded;
+    arc >> loaded;
+    return arc.CheckPoint() && !unpacked.IsError() && SameRecords(records, loaded);
+}
+
+struct Serial : CompressSource      //the serial codec with the parallel one's constructor
+{
+    Serial(IDataSource& source, ThreadPool&) : CompressSource(source, Lz::Default, BLOCK) {}
+};
+struct Parallel : ParallelCompressSource
+{
+    Parallel(IDataSource& source, ThreadPool& pool) : ParallelCompressSource(source, pool, Lz::Default, BLOCK) {}
+};
+
+template<typename Codec>
+bool TwoWay(ThreadPool& pool)       //saves and loads interleaved on one stream, each load stops at the index of its flush
+{
+    MemorySource wire;
+    Codec codec(wire, pool);
+    Archive arc(codec, Archive::Unknown, Archive::Tagged);
+    bool bOk = true;
+    for(int32 round = 0; round < 4; round++)
+    {
+        std::vector<int32> out(1000 + round * 50000, round), in;
+        arc << out;
+        bOk = arc.CheckPoint() && bOk;
+        arc >> in;
+        bOk = arc.CheckPoint() && bOk && (in == out);
+    }
+    return bOk && !codec.IsError();
+}
+
+void PairedCodecs()
+{
+    ThreadPool pool(4);
+    std::vector<Record::shared_ptr> records = GenerateRecords();
+    bool bSerial     = Pairing<Serial, Serial>(records, pool);
+    bool bParallel   = Pairing<Parallel, Parallel>(records, pool);
+    bool bToSerial   = Pairing<Parallel, Serial>(records, pool);
+    bool bFromSerial = Pairing<Serial, Parallel>(records, pool);
+    std::cout << "Codec pairs, saved by -> loaded by:\n"
+              << "  serial -> serial: "     << (bSerial ? "ok" : "FAILED") << "\n"
+              << "  parallel -> parallel: " << (bParallel ? "ok" : "FAILED") << "\n"
+              << "  parallel -> serial: "   << (bToSerial ? "ok" : "FAILED") << "\n"
+              << "  serial -> parallel: "   << (bFromSerial ? "ok" : "FAILED") << "\n";
+    bool bTwoWaySerial   = TwoWay<Serial>(pool);
+    bool bTwoWayParallel = TwoWay<Parallel>(pool);
+    std::cout << "Two way stream, serial: " << (bTwoWaySerial ? "ok" : "FAILED")
+              << ", parallel: " << (bTwoWayParallel ? "ok" : "FAILED") << "\n\n";
+}
+
+template<typename Transform>
+bool Filtered(std::vector<Record::shared_ptr>& records, Transform& saving, Transform& loading, MemorySource& wire)
+{
+    {
+        FilterSource filter(wire, saving);
+        Archive arc(filter);
+        arc << records;
+        arc.CheckPoint();
+    }
+    FilterSource filter(wire, loading);
+    Archive arc(filter, Archive::LoadArchive);
+    std::vector<Record::shared_ptr> loaded;
+    arc >> loaded;
+    return arc.CheckPoint() && SameRecords(records, loaded);
+}
+
+void Transforms()   //FilterSource with each pluggable transform, both ends fed the same bytes in the same order
+{
+    std::vector<Record::shared_ptr> records = GenerateRecords();
+    MemorySource raw;
+    {
+        Archive arc(raw);
+        arc << records;
+        arc.CheckPoint();
+    }
+
+    XorShiftTransform obfuscate(0x5EED), clarify(0x5EED), wrongKey(0x5EEE);
+    MemorySource scrambled;
+    bool bOk = Filtered(records, obfuscate, clarify, scrambled) && (scrambled.Size() == raw.Size()) &&
+               (scrambled.GetData() != raw.GetData());
+    MemorySource replay(scrambled.GetData());
+    {
+        FilterSource filter(replay, wrongKey);
+        Archive arc(filter, Archive::LoadArchive);
+        std::vector<Record::shared_ptr> loaded;
+        arc >> loaded;
+        bOk = bOk && !arc.CheckPoint();     //another seed, another keystream
+    }
+    std::cout << "XorShiftTransform: " << scrambled.Size() << " bytes, keystream applied and removed: " << (bOk ? "ok" : "FAILED") << "\n";
+
+    ChecksumTransform sent, received;
+    MemorySource plain;
+    bOk = Filtered(records, sent, received, plain) && (plain.GetData() == raw.GetData());   //passed through untouched
+    std::vector<BYTE> bytes = raw.GetData();
+    bOk = bOk && (sent.Crc() == received.Crc()) && (sent.Crc() == ~Crc32c::Update(0xFFFFFFFF, bytes.data(), bytes.size()));
+    std::cout << "ChecksumTransform: crc " << std::hex << sent.Crc() << " sent, " << received.Crc() << std::dec
+              << " received: " << (bOk ? "ok" : "FAILED") << "\n\n";
+}
+
+int main()
+{
+    LzRoundTrip();
+    CompressedArchive();
+    PairedCodecs();
+    Transforms();
+    return 0;
+}
@@ -56,6 +56,56 @@ Node4::shared_ptr GenerateNode4Data()
     return a;
 }
 
+class Peer : public Serializable<Peer>
+{
+    using Base = Serializable;
+public:
+    using shared_ptr = std::shared_ptr<Peer>;
+
+    Peer(int32 id = 0) : _id(id) {}
+    void Serialize(Archive& arc)
+    {
+        Base::Serialize(arc);
+        arc.Serialize(_id);
+        arc.Serialize(_links);
+    }
+
+    int32                   _id;
+    std::vector<shared_ptr> _links;
+};
+
+void SharedMesh()       //a fully connected mesh saved from several threads, with and without shared object ids
+{
+    enum { PEERS = 200, };
+    std::vector<Peer::shared_ptr> peers;
+    for(int32 i = 0; i < PEERS; i++)
+        peers.push_back(std::make_shared<Peer>(i));
+    for(Peer::shared_ptr& pPeer : peers)
+        for(Peer::shared_ptr& pOther : peers)
+            if(pOther != pPeer)
+                pPeer->_links.push_back(pOther);
+
+    ThreadPool pool(4);
+    MemorySource privateIds, globalIds;
+    ShardedArchive(privateIds, pool).Save(peers);       //every shard reaches, and saves, the whole mesh
+    ShardedArchive writer(globalIds, pool, Archive::Global);
+    writer.SetRegistry(std::make_shared<IdentityRegistry>());
+    writer.Save(peers);
+
+    std::vector<Peer::shared_ptr> loaded;
+    ShardedArchive reader(globalIds, pool);
+    reader.SetRegistry(std::make_shared<IdentityRegistry>());
+    bool bOk = reader.Load(loaded) && (loaded.size() == PEERS);
+    for(size_t i = 0; bOk && (i < loaded.size()); i++)
+        bOk = (loaded[i]->_id == int32(i)) && (loaded[i]->_links.size() == PEERS - 1) && (loaded[i]->_links[0] == loaded[i ? 0 : 1]);
+    std::cout << "Shared mesh: " << PEERS << " peers in " << 4 * pool.Size() << " shards, private ids " << privateIds.Size()
+              << " bytes, global ids " << globalIds.Size() << " bytes, reloaded: " << (bOk ? "ok" : "FAILED") << "\n\n";
+
+    for(auto* pPeers : { &peers, &loaded })     //break the cycles
+        for(Peer::shared_ptr& pPeer : *pPeers)
+            pPeer->_links.clear();
+}
+
 void Save(IDataSource& sink)
 {
     Archive arc(sink);
@@ -109,6 +159,8 @@ int main()
         std::cout << "Client/Server: Done\n\n";
     }
 
+    SharedMesh();
+
     return 0;
 }
 
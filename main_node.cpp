@@ -58,6 +58,53 @@ Node::shared_ptr GenerateNodeTree()
                         Node::make_shared(15))));
 }
 
+class Link : public Serializable<Link>     //one node of a singly linked chain
+{
+    using Base = Serializable;
+public:
+    using shared_ptr = std::shared_ptr<Link>;
+
+    Link(int32 value = 0, shared_ptr pNext = nullptr) : _value(value), _pNext(pNext) {}
+    ~Link()     //unlink the rest of the chain one node at a time, a chain of destructors could overflow the stack
+    {
+        while(_pNext && (_pNext.use_count() == 1))
+            _pNext = std::move(_pNext->_pNext);
+    }
+    void Serialize(Archive& arc)
+    {
+        Base::Serialize(arc);
+        arc.Serialize(_value);
+        arc.Serialize(_pNext);
+    }
+
+    int32       _value;
+    shared_ptr  _pNext;
+};
+
+void DeepChain()    //Iterative queues each pointee instead of recursing into it, so a long chain does not overflow the stack
+{
+    enum { LINKS = 200000, };
+    Link::shared_ptr pOut;
+    for(int32 i = LINKS; i-- > 0; )
+        pOut = std::make_shared<Link>(i, pOut);
+
+    MemorySource wire;
+    {
+        Archive arc(wire, Archive::SaveArchive, Archive::Iterative);
+        arc << pOut;
+        arc.CheckPoint();
+    }
+    Link::shared_ptr pIn;
+    Archive arc(wire, Archive::LoadArchive, Archive::Iterative);
+    arc >> pIn;
+    bool bOk = arc.CheckPoint();
+    int32 count = 0;
+    for(Link* pLink = pIn.get(); bOk && pLink; pLink = pLink->_pNext.get())
+        bOk = (pLink->_value == count++);
+    bOk = bOk && (count == LINKS);
+    std::cout << "Iterative chain: " << LINKS << " links, " << wire.Size() << " bytes: " << (bOk ? "ok" : "FAILED") << "\n";
+}
+
 int main()
 {
     {
@@ -83,6 +130,8 @@ int main()
         std::cout << Util::DrawTree<decltype(pIn)>(pIn, true) << "\n";
     }
 
+    DeepChain();
+
     return 0;
 }
 
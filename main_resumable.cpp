@@ -0,0 +1,143 @@
+#include <iostream>
+
+#include "Serialize.h"
+
+using namespace Serialize;
+
+#if defined(SERIALIZE_COROUTINES) && !defined(_MSC_VER)
+
+#include <fcntl.h>
+
+class Item : public Serializable<Item>
+{
+public:
+    Item(std::string name = "", int32 count = 0) : _name(name), _count(count) {}
+
+    void Serialize(Archive& arc)
+    {
+        arc.Serialize(_name);
+        arc.Serialize(_count);
+    }
+
+    std::string _name;
+    int32       _count;
+};
+
+class Order : public Serializable<Order>
+{
+public:
+    void Serialize(Archive& arc)
+    {
+        arc.Serialize(_id);
+        arc.Serialize(_customer);
+        arc.Serialize(_items);
+        arc.Serialize(_pGift);
+        arc.Serialize(_notes);
+    }
+
+    int32                               _id = 0;
+    std::string                         _customer;
+    std::vector<std::shared_ptr<Item>>  _items;
+    std::shared_ptr<Item>               _pGift;     //shares one of _items
+    std::vector<std::string>            _notes;
+};
+
+//Loads orders as their messages complete, suspended in between: no thread and no blocking read
+Resumable LoadOrders(IncrementalSource& source, std::vector<Order>& orders)
+{
+    Archive arc(source);                //one archive for the stream, type and object ids carry over
+    while(co_await source.Message())
+    {
+        Order order;
+        arc >> order;
+        if(arc.IsError())
+            co_return;
+        orders.push_back(std::move(order));
+    }
+}
+
+int main()
+{
+    enum { ORDERS = 20, CHUNK = 7, };
+    std::cout << "Resumable load: " << ORDERS << " orders over a non blocking socket, written " << CHUNK << " bytes at a time\n";
+
+    std::vector<Order> sends(ORDERS);   //kept alive while saving: the archive knows objects by address
+    for(int32 n = 0; n < ORDERS; n++)
+    {
+        Order& order = sends[n];
+        order._id = n;
+        order._customer = "customer " + std::to_string(n);
+        for(int32 i = 0; i <= n % 4; i++)
+            order._items.push_back(std::make_shared<Item>("item " + std::to_string(i), n + i));
+        order._pGift = order._items.back();
+        order._notes.assign(n % 3, "fragile");
+    }
+    MemorySource wire;                  //framed orders, one message each, as a client would send them
+    {
+        FrameSource frames(wire);
+        Archive arc(frames);
+        for(Order& order : sends)
+        {
+            arc << order;
+            arc.Flush();
+        }
+    }
+    std::vector<BYTE> bytes = wire.TakeData();
+
+    int fds[2];
+    if(::socketpair(AF_UNIX, SOCK_STREAM, 0, fds))
+        return 1;
+    ::fcntl(fds[1], F_SETFL, ::fcntl(fds[1], F_GETFL) | O_NONBLOCK);
+
+    IncrementalSource source;
+    std::vector<Order> orders;
+    Resumable loader = LoadOrders(source, orders);      //runs up to its first co_await
+
+    size_t sent = 0, reads = 0;
+    BYTE buffer[256];
+    while(!loader.Done())
+    {
+        if(sent < bytes.size())         //the peer dribbles the stream out
+        {
+            size_t size = std::min<size_t>(CHUNK, bytes.size() - sent);
+            sent += size_t(::send(fds[0], bytes.data() + sent, size, 0));
+            if(sent == bytes.size())
+                ::shutdown(fds[0], SHUT_WR);
+        }
+        for(;;)                         //the event loop reads what is there and feeds it
+        {
+            ssize_t ret = ::recv(fds[1], buffer, sizeof(buffer), 0);
+            if(ret > 0)
+                source.Feed(buffer, size_t(ret)), reads++;
+            else
+            {
+                if(ret == 0)
+                    source.End();
+                break;
+            }
+        }
+    }
+    ::close(fds[0]);
+    ::close(fds[1]);
+
+    bool bOk = (orders.size() == ORDERS);
+    for(size_t n = 0; bOk && (n < orders.size()); n++)
+    {
+        Order& order = orders[n];
+        bOk = (order._id == int32(n)) && (order._items.size() == n % 4 + 1) && (order._pGift == order._items.back())
+           && (order._items[0]->_count == int32(n)) && (order._notes.size() == n % 3);
+    }
+    std::cout << orders.size() << " orders from " << bytes.size() << " bytes in " << reads << " reads: " << (bOk ? "ok" : "FAILED") << "\n";
+    std::cout << "Resumable load: Done\n\n";
+    return bOk ? 0 : 1;
+}
+
+#else
+
+int main()
+{
+    std::cout << "Resumable load: needs C++20 coroutines\n";
+    return 0;
+}
+
+#endif
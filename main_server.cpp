@@ -0,0 +1,165 @@
+#include <iostream>
+#include <thread>
+#include <chrono>
+#include <algorithm>
+
+#include "Serialize.h"
+#include "ArchiveServer.h"
+
+using namespace Serialize;
+
+class Order : public Serializable<Order>
+{
+public:
+    void Serialize(Archive& arc)
+    {
+        arc.Serialize(_id);
+        arc.Serialize(_customer);
+        arc.Serialize(_items);
+        arc.Serialize(_total);
+    }
+
+    int32               _id = 0;
+    std::string         _customer;
+    std::vector<int32>  _items;
+    int64               _total = 0;
+};
+
+void Price(Order& order)
+{
+    order._total = 0;
+    for(int32 item : order._items)
+        order._total += item;
+}
+
+#ifdef __linux__
+
+using Clock = std::chrono::steady_clock;
+
+enum { CLIENTS = 8, ROUNDS = 2000, PORT = 27100, };
+
+std::unique_ptr<SocketSource> Connect(short port)     //the server may not be listening yet
+{
+    for(int retry = 0; retry < 500; retry++)
+    {
+        std::unique_ptr<SocketSource> pSocket(new SocketSource("localhost", port));
+        if(pSocket->IsOpen())
+            return pSocket;
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    return nullptr;
+}
+
+void Client(short port, int id, std::vector<double>& latencies)
+{
+    std::unique_ptr<SocketSource> pSocket = Connect(port);
+    if(!pSocket)
+        return;
+    FrameSource frames(*pSocket);
+    Archive arc(frames);
+    Order order;
+    order._customer = "customer " + std::to_string(id);
+    order._items.assign(32, id);
+    for(int round = 0; round < ROUNDS; round++)
+    {
+        order._id = round;
+        Clock::time_point start = Clock::now();
+        arc << order;
+        arc >> order;
+        latencies.push_back(std::chrono::duration<double, std::micro>(Clock::now() - start).count());
+    }
+}
+
+void Report(const char* pName, std::vector<std::vector<double>>& latencies, double seconds)
+{
+    std::vector<double> all;
+    for(auto& client : latencies)
+        all.insert(all.end(), client.begin(), client.end());
+    std::sort(all.begin(), all.end());
+    if(all.empty())
+    {
+        std::cout << pName << ": no replies\n";
+        return;
+    }
+    std::cout << pName << ": " << all.size() << " messages, " << uint64(all.size() / seconds) << " msgs/sec, p50 "
+              << all[all.size() / 2] << "us, p99 " << all[all.size() * 99 / 100] << "us\n";
+}
+
+void RunClients(const char* pName, bool bSharedPort)
+{
+    std::vector<std::vector<double>> latencies(CLIENTS);
+    std::vector<std::thread> clients;
+    Clock::time_point start = Clock::now();
+    for(int i = 0; i < CLIENTS; i++)
+        clients.emplace_back(Client, short(bSharedPort ? PORT : PORT + 1 + i), i, std::ref(latencies[i]));
+    for(std::thread& client : clients)
+        client.join();
+    Report(pName, latencies, std::chrono::duration<double>(Clock::now() - start).count());
+}
+
+void EpollServer()
+{
+    ArchiveServer server([](std::vector<BYTE>& request, std::vector<BYTE>& reply)
+    {
+        Order order;
+        {
+            SpanSource in(request);
+            Archive arc(in);
+            arc >> order;
+        }
+        Price(order);
+        MemorySource out;
+        {
+            Archive arc(out);
+            arc << order;
+        }
+        reply = out.TakeData();
+    });
+    if(!server.Start(PORT))
+    {
+        std::cout << "epoll server: can not listen on " << PORT << "\n";
+        return;
+    }
+    RunClients("epoll server, thread pool", true);
+}
+
+void ThreadPerSocketServer()        //one blocking SocketSource and thread per client, as in main_full.cpp
+{
+    std::vector<std::thread> servers;
+    for(int i = 0; i < CLIENTS; i++)
+        servers.emplace_back([i]
+        {
+            SocketSource socket(short(PORT + 1 + i));
+            FrameSource frames(socket);
+            Archive arc(frames);
+            Order order;
+            for(int round = 0; round < ROUNDS; round++)
+            {
+                arc >> order;
+                Price(order);
+                arc << order;
+            }
+        });
+    RunClients("thread per socket", false);
+    for(std::thread& server : servers)
+        server.join();
+}
+
+int main()
+{
+    std::cout << "Archive server benchmark: " << CLIENTS << " clients x " << ROUNDS << " request/reply\n";
+    EpollServer();
+    ThreadPerSocketServer();
+    std::cout << "Archive server benchmark: Done\n\n";
+    return 0;
+}
+
+#else
+
+int main()
+{
+    std::cout << "Archive server benchmark: epoll is Linux only\n";
+    return 0;
+}
+
+#endif
@@ -1,4 +1,5 @@
 
+#include <chrono>
 #include <iostream>
 
 #include "util.h"
@@ -85,6 +86,191 @@ Node2::shared_ptr GenerateNode2Tree()
                         Node2::make_shared(15))));
 }
 
+Node2::shared_ptr GrowNode2Tree(int32& next, uint32 nodes)     //balanced, numbered in order
+{
+    if(!nodes)
+        return nullptr;
+    uint32 left = (nodes - 1) / 2;
+    Node2::shared_ptr pLeft = GrowNode2Tree(next, left);
+    int32 data = next++;
+    return Node2::make_shared(data, pLeft, GrowNode2Tree(next, nodes - 1 - left));
+}
+
+void ShardedForest()
+{
+    using Clock = std::chrono::steady_clock;
+    auto ms = [](Clock::time_point start) { return std::chrono::duration<double, std::milli>(Clock::now() - start).count(); };
+    enum { TREES = 1000, NODES = 1000, };
+
+    std::vector<Node2::shared_ptr> forest;
+    int32 next = 0;
+    for(int i = 0; i < TREES; i++)
+        forest.push_back(GrowNode2Tree(next, NODES));
+
+    Clock::time_point start = Clock::now();
+    MemorySource serial;
+    {
+        Archive arc(serial);
+        for(Node2::shared_ptr& pTree : forest)
+            arc << pTree;
+    }
+    double serialMs = ms(start);
+
+    ThreadPool pool;
+    MemorySource sharded;
+    start = Clock::now();
+    bool bSaved = ShardedArchive(sharded, pool).Save(forest);
+    double saveMs = ms(start);
+
+    std::vector<Node2::shared_ptr> loaded;
+    start = Clock::now();
+    bool bLoaded = ShardedArchive(sharded, pool).Load(loaded);
+    double loadMs = ms(start);
+
+    MemorySource check;         //the loaded forest saves to the same bytes as the original
+    {
+        Archive arc(check);
+        for(Node2::shared_ptr& pTree : loaded)
+            arc << pTree;
+    }
+    bool bOk = bSaved && bLoaded && (check.GetData() == serial.GetData());
+    std::cout << "Sharded forest: " << TREES << " x " << NODES << " nodes, " << pool.Size() << " threads\n"
+              << "  serial save " << serialMs << "ms (" << serial.Size() << " bytes), sharded save " << saveMs << "ms ("
+              << sharded.Size() << " bytes), sharded load " << loadMs << "ms: " << (bOk ? "ok" : "FAILED") << "\n";
+}
+
+class Forest : public Serializable<Forest>
+{
+    using Base = Serializable;
+public:
+    void Serialize(Archive& arc)
+    {
+        Base::Serialize(arc);
+        arc.Serialize(_trees);
+    }
+
+    std::vector<Lazy<Node2>> _trees;        //loaded one by one, when used
+};
+
+void IndexedForest()
+{
+    using Clock = std::chrono::steady_clock;
+    auto ms = [](Clock::time_point start) { return std::chrono::duration<double, std::milli>(Clock::now() - start).count(); };
+    enum { TREES = 1000, NODES = 1000, PICK = 500, };
+
+    auto pForest = std::make_shared<Forest>();
+    int32 next = 0;
+    for(int i = 0; i < TREES; i++)
+        pForest->_trees.emplace_back(GrowNode2Tree(next, NODES));
+
+    MemorySource indexed;
+    Clock::time_point start = Clock::now();
+    {
+        IndexedWriter writer(indexed);
+        writer.Save("forest", pForest);
+        writer.Save("tree " + std::to_string(PICK), pForest->_trees[PICK].Get());
+    }
+    double saveMs = ms(start);
+
+    start = Clock::now();
+    IndexedReader reader(indexed);
+    double openMs = ms(start);
+    start = Clock::now();
+    std::shared_ptr<Forest> pLoaded;
+    bool bOk = reader.Load("forest", pLoaded) && (pLoaded->_trees.size() == TREES);
+    uint64 forestRecords = reader.Records();
+    Node2::shared_ptr pTree = pLoaded ? pLoaded->_trees[PICK].Get() : nullptr;      //one tree out of the forest
+    double loadMs = ms(start);
+    Node2::shared_ptr pNamed;
+    bOk = bOk && pTree && reader.Load("tree " + std::to_string(PICK), pNamed) && (pNamed == pTree);
+    bOk = bOk && !pLoaded->_trees[PICK + 1].IsLoaded();
+
+    MemorySource original, loaded;      //the tree saves to the same bytes as the one it came from
+    {
+        Node2::shared_ptr pSaved = pForest->_trees[PICK].Get();
+        Archive arc(original);
+        arc << pSaved;
+    }
+    {
+        Archive arc(loaded);
+        arc << pTree;
+    }
+    bOk = bOk && (original.GetData() == loaded.GetData());
+    std::cout << "Indexed forest: " << reader.Objects() << " records, " << indexed.Size() << " bytes, saved in " << saveMs << "ms, index read in " << openMs << "ms\n"
+              << "  forest (" << forestRecords << " record) and tree " << PICK << " (" << reader.Records() - forestRecords
+              << " records) loaded in " << loadMs << "ms: " << (bOk ? "ok" : "FAILED") << "\n";
+}
+
+bool LoadTree(IDataSource& source, uint32 format, Node2::shared_ptr& pTree)
+{
+    Archive arc(source, Archive::LoadArchive, format);
+    arc >> pTree;
+    return arc.CheckPoint();
+}
+
+void CheckedTree(const char* pName, uint32 format, bool bCorrupt)   //a tree through a CheckPoint, bCorrupt: a flipped bit must fail it
+{
+    enum { NODES = 10000, };
+    int32 next = 0;
+    Node2::shared_ptr pTree = GrowNode2Tree(next, NODES);
+    MemorySource wire;
+    {
+        Archive arc(wire, Archive::SaveArchive, format);
+        arc << pTree;
+        arc.CheckPoint();
+    }
+    std::vector<BYTE> bytes = wire.GetData();
+    Node2::shared_ptr pIn;
+    bool bOk = LoadTree(wire, format, pIn);
+    MemorySource check;         //the loaded tree saves to the same bytes
+    {
+        Archive arc(check, Archive::SaveArchive, format);
+        arc << pIn;
+        arc.CheckPoint();
+    }
+    bOk = bOk && (check.GetData() == bytes);
+    std::cout << pName << " tree: " << NODES << " nodes, " << bytes.size() << " bytes: " << (bOk ? "ok" : "FAILED") << "\n";
+    if(!bCorrupt)
+        return;
+    bytes[bytes.size() / 2] ^= 0x01;
+    MemorySource corrupted(bytes);
+    bool bCaught = !LoadTree(corrupted, format, pIn);
+    std::cout << "  a bit flipped: " << (bCaught ? "CheckPoint failed, ok" : "CheckPoint passed, FAILED") << "\n";
+}
+
+void ArenaTree()    //a tree loaded with its nodes and their control blocks bumped out of an arena
+{
+    enum { NODES = 100000, };
+    int32 next = 0;
+    Node2::shared_ptr pTree = GrowNode2Tree(next, NODES);
+    MemorySource wire;
+    {
+        Archive arc(wire, Archive::SaveArchive);
+        arc << pTree;
+        arc.CheckPoint();
+    }
+    Node2::shared_ptr pIn;
+    auto pArena = std::make_shared<Arena>();
+    bool bOk = false;
+    {
+        Archive arc(wire, Archive::LoadArchive);
+        arc.SetArena(pArena);
+        arc >> pIn;
+        bOk = arc.CheckPoint();
+    }
+    size_t used = pArena->Used();
+    pArena = nullptr;            //the nodes keep the arena alive
+
+    MemorySource check;
+    {
+        Archive arc(check, Archive::SaveArchive);
+        arc << pIn;
+        arc.CheckPoint();
+    }
+    bOk = bOk && used && (check.GetData() == wire.GetData());   //the loaded tree saves to the same bytes
+    std::cout << "Arena tree: " << NODES << " nodes loaded into " << used << " arena bytes: " << (bOk ? "ok" : "FAILED") << "\n";
+}
+
 int main()
 {
     Node2::shared_ptr p2Tree = GenerateNode2Tree();
@@ -92,6 +278,11 @@ int main()
     std::cout << "Node2 Tree:\n";
     std::cout << Util::DrawTree<decltype(p2Tree)>(p2Tree, true) << "\n";
 
+    ShardedForest();
+    IndexedForest();
+    CheckedTree("Checksummed", Archive::Checksummed, true);
+    CheckedTree("NoHash", Archive::NoHash, false);     //nothing hashed to check a flipped bit against
+    ArenaTree();
     return 0;
 }
 
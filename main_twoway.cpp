@@ -55,26 +55,50 @@ protected:
     shared_ptr  _pRight;
 };
 
+class CountSource : public IDataSource      //bytes saved through to another source
+{
+    IDataSource&    _source;
+    uint64          _saved = 0;
+
+    virtual int32 save(void* pData, uint32 size)    { int32 ret = _source.save(pData, size); _saved += (ret > 0) ? ret : 0; return ret; }
+    virtual int32 load(void* pData, uint32 size)    { return _source.load(pData, size); }
+    virtual void  flush()                           { _source.flush(); }
+
+public:
+    CountSource(IDataSource& source) : _source(source) {}
+    uint64 Saved() { uint64 saved = _saved; _saved = 0; return saved; }    //since the last call
+};
+
 void Server()
 {
     Util::Rand rand;
     std::cout << "Two Way Server: starting\n";
     SocketSource server;
-    Archive arc(server);
+    CountSource counted(server);
+    FrameSource frames(counted);    //each << is one length prefixed message
+    Archive arc(frames, Archive::Unknown, Archive::Delta | Archive::Session);      //after the first, messages carry only the changes
 
-    Node3::shared_ptr pTree = Node3::make_shared("Root", 5);
+    Node3::shared_ptr pTree = Node3::make_shared("Root", 50);
+    for(int i = 0; i < 30; i++)
+        pTree->Insert(Node3::make_shared("Seed", rand.get(100)));
     int count = 5;
     while(count--)
     {
-        std::cout << "<<S";
         arc << pTree;
+        arc.Flush();
+        std::cout << "<<S:" << counted.Saved() << " ";
         pTree = nullptr;
 
-        std::cout << ">>S";
+        std::cout << ">>S ";
         arc >> pTree;
-        pTree->Insert(Node3::make_shared("Server", rand.get(10)));
+        pTree->Insert(Node3::make_shared("Server", rand.get(100)));
     }
-    std::cout << "\nServer:\n" << Util::DrawTree<decltype(pTree)>(pTree, true) << "\n";
+    MemorySource full;
+    {
+        Archive arc(full);
+        arc << pTree;
+    }
+    std::cout << "\nServer: whole tree " << full.Size() << " bytes\n" << Util::DrawTree<decltype(pTree)>(pTree, true) << "\n";
     std::cout << "Two Way Server: exiting\n";
 }
 
@@ -82,23 +106,50 @@ void Client()
 {
     std::cout << "Two Way Client: starting\n";
     SocketSource client("localhost");
-    Archive arc(client);
+    CountSource counted(client);
+    FrameSource frames(counted);
+    Archive arc(frames, Archive::Unknown, Archive::Delta | Archive::Session);
     Util::Rand rand;
     int count = 5;
     while(count--)
     {
         Node3::shared_ptr pTree;
-        std::cout << ">>C";
-        arc >> pTree;
+        std::cout << ">>C ";
+        arc >> pTree;           //the tree loaded before, patched
 
-        pTree->Insert(Node3::make_shared("Client", rand.get(10)));
+        pTree->Insert(Node3::make_shared("Client", rand.get(100)));
 
-        std::cout << "<<C";
         arc << pTree;
+        arc.Flush();
+        std::cout << "<<C:" << counted.Saved() << " ";
     }
     std::cout << "\nTwo Way Client: exiting\n";
 }
 
+void ForwardView()      //inspect a loaded view and save it on, one archive, the view's bytes copied out of a stream once
+{
+#if __cplusplus >= 201703L
+    std::string payload(100000, 'p');
+    MemorySource wire;      //not memory the archive can view in place, loaded views are copies the archive keeps
+    {
+        Archive arc(wire, Archive::SaveArchive, Archive::Tagged);
+        arc << payload;
+        arc.CheckPoint();
+    }
+    Archive arc(wire, Archive::Unknown, Archive::Tagged);
+    std::string_view view;
+    arc >> view;
+    bool bOk = arc.CheckPoint() && (view == payload);
+    arc << view;            //forwarded, the copy outlives the switch to saving
+    bOk = arc.CheckPoint() && bOk;
+
+    std::string forwarded;
+    Archive check(wire, Archive::LoadArchive, Archive::Tagged);
+    check >> forwarded;
+    bOk = check.CheckPoint() && bOk && (forwarded == payload);
+    std::cout << "Forwarded view: " << view.size() << " bytes: " << (bOk ? "ok" : "FAILED") << "\n\n";
+#endif
+}
 
 int main()
 {
@@ -110,6 +161,8 @@ int main()
     client.join();
 
     std::cout << "Client/Server Synchronous Reversible-Two Way Archive: Done\n\n";
+
+    ForwardView();
 }
 
 